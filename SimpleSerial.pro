@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui network
+QT       += core gui network concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -31,17 +31,54 @@ SOURCES += \
     src/main.cpp\
     src/Utilities.cpp \
     src/aboutdialog.cpp \
+    src/gidchecksum.cpp \
     src/gidtcp.cpp \
     src/gidudp.cpp \
     src/mainwindow.cpp \
-    src/gidconsolewidget.cpp
+    src/gidconsoleformatter.cpp \
+    src/gidconsolesearch.cpp \
+    src/gidconsolewidget.cpp \
+    src/giddatagramlimiter.cpp \
+    src/gidframer.cpp \
+    src/gidhexdumpwidget.cpp \
+    src/gidlatencyprobe.cpp \
+    src/gidmessagecompiler.cpp \
+    src/gidmetrics.cpp \
+    src/gidpatterntest.cpp \
+    src/gidplotwidget.cpp \
+    src/gidprotocoldecoder.cpp \
+    src/gidreconnectsupervisor.cpp \
+    src/gidsettings.cpp \
+    src/gidspillfile.cpp \
+    src/gidsocketoptions.cpp \
+    src/gidstartupprofile.cpp \
+    src/gidtimestamp.cpp
 
 HEADERS  += \
     src/mainwindow.h \
     src/Utilities.h \
     src/aboutdialog.h \
+    src/gidchecksum.h \
+    src/gidchunk.h \
+    src/gidconsoleformatter.h \
+    src/gidconsolesearch.h \
     src/gidconsolewidget.h \
+    src/giddatagramlimiter.h \
+    src/gidframer.h \
+    src/gidhexdumpwidget.h \
+    src/gidlatencyprobe.h \
+    src/gidmessagecompiler.h \
+    src/gidmetrics.h \
+    src/gidpatterntest.h \
+    src/gidplotwidget.h \
+    src/gidprotocoldecoder.h \
+    src/gidreconnectsupervisor.h \
+    src/gidsettings.h \
+    src/gidspillfile.h \
+    src/gidsocketoptions.h \
+    src/gidstartupprofile.h \
     src/gidtcp.h \
+    src/gidtimestamp.h \
     src/gidudp.h \
     src/version.h
 
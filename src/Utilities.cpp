@@ -48,3 +48,22 @@ QSize Utilities::scaleWithPrimaryScreenScalingFactor(QSize size)
                           / baselineDpi;
     return size * scalingFactor;
 }
+
+QString Utilities::bytesToString(double bytes)
+{
+    static const QStringList units({"B", "kB", "MB", "GB", "TB"});
+    int i = 0;
+    while ((qAbs(bytes) >= 1000.0) && (i < units.count() - 1)) {
+        bytes /= 1000.0;
+        i++;
+    }
+    int decimals = (i == 0) ? 0 : 2;
+    return QString("%1 %2").arg(bytes, 0, 'f', decimals).arg(units[i]);
+}
+
+QString Utilities::usToString(qint64 us)
+{
+    if (qAbs(us) < 1000) { return QString("%1 us").arg(us); }
+    if (qAbs(us) < 1000000) { return QString("%1 ms").arg(us / 1000.0, 0, 'f', 2); }
+    return QString("%1 s").arg(us / 1000000.0, 0, 'f', 3);
+}
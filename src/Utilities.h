@@ -29,6 +29,11 @@ public:
     static QFont getMonospaceFont();
 
     static QSize scaleWithPrimaryScreenScalingFactor(QSize size);
+
+    // Human readable size, e.g. "1.50 MB". Uses decimal (SI) prefixes.
+    static QString bytesToString(double bytes);
+    // Human readable duration, e.g. "850 us", "12.34 ms" or "1.500 s"
+    static QString usToString(qint64 us);
 };
 
 #endif // UTILITIES_H
@@ -0,0 +1,202 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidchecksum.h"
+
+
+namespace {
+
+quint32 reflect(quint32 value, int bits)
+{
+    quint32 r = 0;
+    for (int i = 0; i < bits; i++) {
+        if (value & (quint32(1) << i)) { r |= quint32(1) << (bits - 1 - i); }
+    }
+    return r;
+}
+
+quint32 load32le(const uchar* p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16)
+            | (quint32(p[3]) << 24);
+}
+
+} // namespace
+
+GidChecksum::GidChecksum(QString name, Kind kind, int width, quint32 poly,
+                         quint32 init, quint32 xorOut) :
+    mName(name),
+    mKind(kind),
+    mWidth(width),
+    mInit(init),
+    mXorOut(xorOut)
+{
+    quint32 mask = (width == 32) ? 0xFFFFFFFF : ((quint32(1) << width) - 1);
+
+    if (kind == KindCrcNormal) {
+        mTable.resize(256);
+        quint32 top = quint32(1) << (width - 1);
+        for (int i = 0; i < 256; i++) {
+            quint32 crc = quint32(i) << (width - 8);
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & top) ? ((crc << 1) ^ poly) : (crc << 1);
+            }
+            mTable[i] = crc & mask;
+        }
+    } else if ((kind == KindCrcReflected) || (kind == KindCrc32Slice8)) {
+        quint32 rpoly = reflect(poly, width);
+        mTable.resize((kind == KindCrc32Slice8) ? 8 * 256 : 256);
+        for (int i = 0; i < 256; i++) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? ((crc >> 1) ^ rpoly) : (crc >> 1);
+            }
+            mTable[i] = crc;
+        }
+        if (kind == KindCrc32Slice8) {
+            // Table k gives the CRC of a byte followed by k zero bytes
+            for (int k = 1; k < 8; k++) {
+                for (int i = 0; i < 256; i++) {
+                    quint32 prev = mTable[(k - 1) * 256 + i];
+                    mTable[k * 256 + i] = (prev >> 8) ^ mTable[prev & 0xFF];
+                }
+            }
+        }
+    }
+}
+
+const QList<const GidChecksum*>& GidChecksum::all()
+{
+    // Created once on first use and never deleted
+    static const QList<const GidChecksum*> list {
+        new GidChecksum("crc8",              KindCrcNormal,    8,  0x07,   0x00,   0x00),
+        new GidChecksum("crc8-maxim",        KindCrcReflected, 8,  0x31,   0x00,   0x00),
+        new GidChecksum("crc16-modbus",      KindCrcReflected, 16, 0x8005, 0xFFFF, 0x0000),
+        new GidChecksum("crc16-ccitt-false", KindCrcNormal,    16, 0x1021, 0xFFFF, 0x0000),
+        new GidChecksum("crc16-xmodem",      KindCrcNormal,    16, 0x1021, 0x0000, 0x0000),
+        new GidChecksum("crc16-kermit",      KindCrcReflected, 16, 0x1021, 0x0000, 0x0000),
+        new GidChecksum("crc16-x25",         KindCrcReflected, 16, 0x1021, 0xFFFF, 0xFFFF),
+        new GidChecksum("crc32",             KindCrc32Slice8,  32, 0x04C11DB7,
+                        0xFFFFFFFF, 0xFFFFFFFF),
+        new GidChecksum("lrc",               KindLrc,          8,  0, 0, 0),
+        new GidChecksum("xor",               KindXor,          8,  0, 0, 0),
+        new GidChecksum("sum8",              KindSum8,         8,  0, 0, 0)
+    };
+    return list;
+}
+
+const GidChecksum& GidChecksum::get(Algorithm algorithm)
+{
+    return *all().at(algorithm);
+}
+
+const GidChecksum* GidChecksum::find(QString name)
+{
+    name = name.trimmed().toLower();
+    foreach (const GidChecksum* c, all()) {
+        if (c->mName == name) { return c; }
+    }
+    return nullptr;
+}
+
+QStringList GidChecksum::names()
+{
+    QStringList ret;
+    foreach (const GidChecksum* c, all()) { ret.append(c->mName); }
+    return ret;
+}
+
+quint32 GidChecksum::update(quint32 state, const char* data, int len) const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    const quint32* t = mTable.constData();
+    quint32 crc = state;
+
+    switch (mKind) {
+    case KindCrc32Slice8:
+        while (len >= 8) {
+            quint32 one = load32le(p) ^ crc;
+            quint32 two = load32le(p + 4);
+            crc = t[7 * 256 + (one & 0xFF)]
+                ^ t[6 * 256 + ((one >> 8) & 0xFF)]
+                ^ t[5 * 256 + ((one >> 16) & 0xFF)]
+                ^ t[4 * 256 + (one >> 24)]
+                ^ t[3 * 256 + (two & 0xFF)]
+                ^ t[2 * 256 + ((two >> 8) & 0xFF)]
+                ^ t[1 * 256 + ((two >> 16) & 0xFF)]
+                ^ t[0 * 256 + (two >> 24)];
+            p += 8;
+            len -= 8;
+        }
+        // The remaining bytes one at a time
+        Q_FALLTHROUGH();
+    case KindCrcReflected:
+        for (int i = 0; i < len; i++) {
+            crc = (crc >> 8) ^ t[(crc ^ p[i]) & 0xFF];
+        }
+        break;
+    case KindCrcNormal: {
+        int shift = mWidth - 8;
+        quint32 mask = (mWidth == 32) ? 0xFFFFFFFF : ((quint32(1) << mWidth) - 1);
+        for (int i = 0; i < len; i++) {
+            crc = ((crc << 8) ^ t[((crc >> shift) ^ p[i]) & 0xFF]) & mask;
+        }
+        break;
+    }
+    case KindLrc:
+    case KindSum8:
+        // For LRC, the sum is negated by final()
+        for (int i = 0; i < len; i++) { crc += p[i]; }
+        crc &= 0xFF;
+        break;
+    case KindXor:
+        for (int i = 0; i < len; i++) { crc ^= p[i]; }
+        break;
+    }
+
+    return crc;
+}
+
+quint32 GidChecksum::final(quint32 state) const
+{
+    if (mKind == KindLrc) { return (0x100 - state) & 0xFF; }
+    return state ^ mXorOut;
+}
+
+QByteArray GidChecksum::toBytes(quint32 value, Format format) const
+{
+    int n = size();
+    if (format == FormatDefault) {
+        // Reflected CRCs are sent least significant byte first
+        bool reflected = (mKind == KindCrcReflected) || (mKind == KindCrc32Slice8);
+        format = reflected ? FormatLittleEndian : FormatBigEndian;
+    }
+
+    QByteArray ret;
+    if (format == FormatHex) {
+        ret = QByteArray::number(value, 16).toUpper().rightJustified(n * 2, '0');
+    } else {
+        for (int i = 0; i < n; i++) {
+            int shift = (format == FormatLittleEndian) ? i * 8 : (n - 1 - i) * 8;
+            ret.append(char((value >> shift) & 0xFF));
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDCHECKSUM_H
+#define GIDCHECKSUM_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/* GidChecksum computes CRCs and simple checksums over bytes.
+ *
+ * CRCs are table-driven, one byte at a time. CRC32 uses slice-by-8, which
+ * processes 8 bytes per step with 8 tables.
+ *
+ * Checksums can be computed in one go with compute(), or incrementally with
+ * initial(), update() and final(). */
+class GidChecksum
+{
+public:
+    enum Algorithm {
+        Crc8,           // CRC-8/SMBUS
+        Crc8Maxim,      // CRC-8/MAXIM-DOW (Dallas 1-Wire)
+        Crc16Modbus,
+        Crc16CcittFalse,
+        Crc16Xmodem,
+        Crc16Kermit,
+        Crc16X25,
+        Crc32,          // CRC-32/ISO-HDLC (Ethernet, zip)
+        Lrc,            // Two's complement of the 8-bit sum (Modbus ASCII)
+        Xor,            // XOR of all bytes (NMEA)
+        Sum8            // 8-bit sum
+    };
+
+    enum Format {
+        FormatDefault,      // Byte order of the protocol the algorithm is used in
+        FormatLittleEndian,
+        FormatBigEndian,
+        FormatHex           // Uppercase ASCII hex digits, most significant first
+    };
+
+    static const GidChecksum& get(Algorithm algorithm);
+    // Find by name, e.g. "crc16-modbus". Returns null if not found.
+    static const GidChecksum* find(QString name);
+    static QStringList names();
+
+    QString name() const { return mName; }
+    // Size of the checksum in bytes
+    int size() const { return mWidth / 8; }
+
+    quint32 initial() const { return mInit; }
+    quint32 update(quint32 state, const char* data, int len) const;
+    quint32 final(quint32 state) const;
+    quint32 compute(const char* data, int len) const
+    {
+        return final(update(initial(), data, len));
+    }
+    quint32 compute(const QByteArray& data) const
+    {
+        return compute(data.constData(), data.count());
+    }
+
+    QByteArray toBytes(quint32 value, Format format = FormatDefault) const;
+
+private:
+    enum Kind { KindCrcNormal, KindCrcReflected, KindCrc32Slice8, KindLrc,
+                KindXor, KindSum8 };
+
+    GidChecksum(QString name, Kind kind, int width, quint32 poly, quint32 init,
+                quint32 xorOut);
+
+    QString mName;
+    Kind mKind;
+    int mWidth;
+    quint32 mInit;
+    quint32 mXorOut;
+    QVector<quint32> mTable; // 256 entries, or 8 x 256 for slice-by-8
+
+    // Indexed by Algorithm
+    static const QList<const GidChecksum*>& all();
+};
+
+#endif // GIDCHECKSUM_H
@@ -0,0 +1,48 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDCHUNK_H
+#define GIDCHUNK_H
+
+#include "gidtimestamp.h"
+
+#include <QByteArray>
+#include <QString>
+
+/* A chunk of data as it was received from (or sent to) a port, together with
+ * the time it was read (or written). The timestamp is taken as close to the
+ * port as possible and carried along through display and logging.
+ * frameStart marks the start of a frame from a framer, which is displayed on
+ * a new line. tag names the source of a frame, e.g. the sender of a UDP
+ * datagram, and is shown at its start. */
+struct GidChunk
+{
+    GidChunk() {}
+    GidChunk(const QByteArray& data, const GidTimestamp& timestamp,
+             bool frameStart = false) :
+        data(data), timestamp(timestamp), frameStart(frameStart) {}
+
+    QByteArray data;
+    GidTimestamp timestamp;
+    bool frameStart = false;
+    QString tag;
+};
+
+#endif // GIDCHUNK_H
@@ -0,0 +1,301 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidconsoleformatter.h"
+
+#include "Utilities.h"
+
+
+namespace {
+
+const QColor textColor(Qt::black);
+const QColor markerColor(Qt::red);
+const QColor timestampColor(Qt::blue);
+const QColor noteColor(Qt::darkGray);
+const QColor decodedColor(Qt::darkMagenta);
+
+} // namespace
+
+QString GidConsoleFormatter::Segment::unwrapped() const
+{
+    if (wraps.isEmpty()) { return text; }
+    QString t;
+    t.reserve(text.length() - wraps.count());
+    int from = 0;
+    foreach (int pos, wraps) {
+        t += text.midRef(from, pos - from);
+        from = pos + 1;
+    }
+    t += text.midRef(from);
+    return t;
+}
+
+void GidConsoleFormatter::startNewLine()
+{
+    mColumn = 0;
+    mLastWasHex = false;
+    mLastWasNewline = true;
+}
+
+void GidConsoleFormatter::format(const GidChunk& chunk, Direction dir,
+                                 QList<Segment>& out)
+{
+    const Options& opt = mOptions;
+    mOut = &out;
+
+    if ((dir == Decoded) || (dir == DecodedError)) {
+        formatDecoded(chunk, dir == Decoded);
+        mOut = nullptr;
+        return;
+    }
+
+    // Time grouping is based on when the data was read, not when it is shown.
+    bool timestampTimeElapsed =
+               !mLastTimestamp.isValid()
+            || (mLastTimestamp.usecsTo(chunk.timestamp) > opt.timestampTimeLimitMs * 1000);
+    if (timestampTimeElapsed) { mLastTimestamp = chunk.timestamp; }
+
+    // Each frame starts on a new line
+    if (chunk.frameStart) {
+        if (mColumn != 0) { add("\n", textColor); }
+        mLastWasHex = false;
+        mLastWasNewline = true;
+    }
+
+    bool timestampShown = false;
+
+    // Tagged frames start with their time and source
+    if (chunk.frameStart && !chunk.tag.isEmpty()) {
+        QString t;
+        mTimestampFormatter.appendTo(t, chunk.timestamp);
+        t += " " + chunk.tag + ": ";
+        add(t, timestampColor);
+        mLastWasNewline = false;
+        timestampShown = true;
+    }
+
+    if (chunk.data.isEmpty()) {
+        mOut = nullptr;
+        return;
+    }
+
+    /* Where timestamps go is decided once for the chunk. Sent data gets one
+     * timestamp at its start. Received data gets one at its start or after
+     * each newline, unless it is within the grouping time of the previous
+     * timestamp. */
+    bool timestampAtStart = false;
+    bool timestampAfterNewline = false;
+    if (opt.timestamps) {
+        bool groupingAllows = !opt.timestampTimeLimitMs || timestampTimeElapsed;
+        if (dir == Send) {
+            timestampAtStart = !timestampShown;
+        } else if (opt.timestampsAfterNewline) {
+            timestampAfterNewline = groupingAllows;
+        } else {
+            timestampAtStart = !timestampShown && groupingAllows;
+        }
+    }
+
+    bool separateLine = (dir == Send) && opt.sentDataOnSeparateLine;
+
+    // If showing send data, add a newline before it if set
+    if (separateLine && (mColumn != 0)) { add("\n", textColor); }
+
+    // The formatting mode is chosen once per chunk
+    if (opt.hex) {
+        formatData<true, false>(chunk, timestampAtStart, timestampAfterNewline);
+    } else if (opt.hexForSpecialChars) {
+        formatData<false, true>(chunk, timestampAtStart, timestampAfterNewline);
+    } else {
+        formatData<false, false>(chunk, timestampAtStart, timestampAfterNewline);
+    }
+
+    // Newline after showing send data
+    if (separateLine && (mColumn != 0)) {
+        add("\n", textColor);
+        mLastWasHex = false;
+    }
+
+    mOut = nullptr;
+}
+
+void GidConsoleFormatter::formatGap(int chunks, qint64 bytes, QList<Segment>& out)
+{
+    mOut = &out;
+    QString t;
+    if (mColumn != 0) { t += "\n"; }
+    t += QString("... %1 chunks (%2) not displayed\n")
+            .arg(chunks).arg(Utilities::bytesToString(bytes));
+    add(t, noteColor);
+    mLastWasHex = false;
+    mLastWasNewline = true;
+    mOut = nullptr;
+}
+
+// A decoded message is shown on a line of its own
+void GidConsoleFormatter::formatDecoded(const GidChunk& chunk, bool checksumOk)
+{
+    QString t;
+    if (mColumn != 0) { t += "\n"; }
+    if (mOptions.timestamps) {
+        mTimestampFormatter.appendTo(t, chunk.timestamp);
+        t += ": ";
+    }
+    t += QString("[%1] %2").arg(chunk.tag).arg(QString::fromUtf8(chunk.data));
+    if (!checksumOk) { t += " <checksum error>"; }
+    t += "\n";
+    add(t, checksumOk ? decodedColor : markerColor);
+    mLastWasHex = false;
+    mLastWasNewline = true;
+}
+
+// The last segment, if it has the given colour, or a new segment
+GidConsoleFormatter::Segment& GidConsoleFormatter::segment(const QColor& color)
+{
+    if (mOut->isEmpty() || (mOut->last().color != color)) {
+        mOut->append({QString(), color, QVector<int>()});
+    }
+    return mOut->last();
+}
+
+/* Adds a character and wraps the line when it reaches the console width, the
+ * same way GidConsoleWidget::addText() does. */
+inline void GidConsoleFormatter::put(Segment& out, QChar c)
+{
+    out.text += c;
+    if (c == '\n') {
+        mColumn = 0;
+        return;
+    }
+    mColumn += (c == '\t') ? mOptions.tabChars : 1;
+    if (mColumn >= mOptions.lineChars) {
+        out.wraps.append(out.text.length());
+        out.text += '\n';
+        mColumn = 0;
+    }
+}
+
+void GidConsoleFormatter::add(const QString& text, const QColor& color)
+{
+    Segment& out = segment(color);
+    for (QChar c : text) { put(out, c); }
+}
+
+/* Text that does not fit on the rest of the line is moved to the next line as
+ * a whole. */
+void GidConsoleFormatter::addNonBreaking(QString text, const QColor& color,
+                                         bool virtuallyAtLineStart,
+                                         bool addSpaceBefore)
+{
+    bool addedNewline = false;
+    int lenToAdd = text.length();
+    if (addSpaceBefore) { lenToAdd += 1; }
+    if ((mOptions.lineChars - mColumn) < lenToAdd) {
+        text.prepend("\n");
+        addedNewline = true;
+    }
+
+    // Add space before if set, but only if we are not at the start of a line
+    if (addSpaceBefore) {
+        bool atStartOfLine = virtuallyAtLineStart || addedNewline;
+        if (!atStartOfLine) {
+            text.prepend(" ");
+        }
+    }
+
+    add(text, color);
+}
+
+void GidConsoleFormatter::addMarker(const QString& marker)
+{
+    if (mLastWasHex) {
+        add(" ", textColor);
+        mLastWasHex = false;
+    }
+    addNonBreaking(marker, markerColor);
+}
+
+/* In hex mode (Hex), all bytes are shown in hex and newlines are treated as
+ * normal data. In text mode, special characters other than CR, LF and tab are
+ * shown in hex if HexForSpecialChars is set. */
+template<bool Hex, bool HexForSpecialChars>
+void GidConsoleFormatter::formatData(const GidChunk& chunk, bool timestampAtStart,
+                                     bool timestampAfterNewline)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    const Options& opt = mOptions;
+    const char* data = chunk.data.constData();
+    int n = chunk.data.count();
+
+    for (int i = 0; i < n; i++) {
+
+        unsigned char c = data[i];
+
+        bool printTimestamp = (timestampAtStart && (i == 0))
+                || (timestampAfterNewline && mLastWasNewline);
+        if (printTimestamp) {
+            QString t;
+            if (mColumn != 0) {
+                t += "\n";
+            }
+            mTimestampFormatter.appendTo(t, chunk.timestamp);
+            t += ": ";
+            add(t, timestampColor);
+            mLastWasHex = false;
+        }
+
+        bool outputHex = Hex;
+        if (HexForSpecialChars) {
+            bool special = ((c < 32) || (c == 127));
+            bool notCrLfTab = (c != '\t') && (c != '\n') && (c != '\r');
+            outputHex = special && notCrLfTab;
+        }
+
+        if (outputHex) {
+            QString hex(2, QChar());
+            hex[0] = QLatin1Char(digits[c >> 4]);
+            hex[1] = QLatin1Char(digits[c & 0xF]);
+            bool virtuallyAtLineStart = printTimestamp || (mColumn == 0);
+            addNonBreaking(hex, markerColor, virtuallyAtLineStart, true);
+            mLastWasHex = true;
+        } else if (c == '\n') {
+            if (opt.showCrLfHex) { addMarker("<LF>"); }
+            if (opt.crLfNewline) {
+                Segment& out = segment(textColor);
+                if (mLastWasHex) {
+                    put(out, ' ');
+                    mLastWasHex = false;
+                }
+                put(out, '\n');
+            }
+        } else if (c == '\r') {
+            if (opt.showCrLfHex) { addMarker("<CR>"); }
+        } else {
+            Segment& out = segment(textColor);
+            if (mLastWasHex) {
+                put(out, ' ');
+                mLastWasHex = false;
+            }
+            put(out, QChar(c));
+        }
+
+        mLastWasNewline = (c == '\n');
+    }
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDCONSOLEFORMATTER_H
+#define GIDCONSOLEFORMATTER_H
+
+#include "gidchunk.h"
+
+#include <QColor>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+/* GidConsoleFormatter turns received and sent data into text for the console:
+ * hex bytes, CR/LF markers, timestamps and sender tags, wrapped at the width
+ * of the console. It does not touch any widgets, so it can run on a worker
+ * thread while the console only appends the resulting segments.
+ *
+ * The formatter keeps track of the console line it is writing to. When other
+ * text is added to the console, startNewLine() tells it the console is at the
+ * start of a line again. */
+class GidConsoleFormatter
+{
+public:
+    /* Decoded chunks hold the text of a message decoded from received data,
+     * with the decoder name as tag. DecodedError is used for a message with
+     * a checksum error. */
+    enum Direction { Receive, Send, Decoded, DecodedError };
+
+    struct Options {
+        bool hex = false;
+        bool hexForSpecialChars = false;
+        bool showCrLfHex = false;
+        bool crLfNewline = false;
+        bool sentDataOnSeparateLine = false;
+        bool timestamps = false;
+        bool timestampsAfterNewline = false;
+        int timestampTimeLimitMs = 0;
+        // Console line and tab widths in characters
+        int lineChars = 80;
+        int tabChars = 8;
+    };
+
+    /* Text in one colour, with newlines at the wrap points. wraps holds the
+     * positions in text of the newlines added by wrapping. */
+    struct Segment {
+        QString text;
+        QColor color;
+        QVector<int> wraps;
+
+        // Text without the newlines added by wrapping
+        QString unwrapped() const;
+    };
+
+    void setOptions(const Options& options) { mOptions = options; }
+    void startNewLine();
+    // Appends the formatted chunk to out
+    void format(const GidChunk& chunk, Direction dir, QList<Segment>& out);
+    // Appends a note that chunks were dropped from the display
+    void formatGap(int chunks, qint64 bytes, QList<Segment>& out);
+
+private:
+    Options mOptions;
+    GidTimestampFormatter mTimestampFormatter;
+    GidTimestamp mLastTimestamp;
+    int mColumn = 0;
+    bool mLastWasHex = false;
+    bool mLastWasNewline = false;
+    QList<Segment>* mOut = nullptr;
+
+    Segment& segment(const QColor& color);
+    void put(Segment& out, QChar c);
+    void add(const QString& text, const QColor& color);
+    void addNonBreaking(QString text, const QColor& color,
+                        bool virtuallyAtLineStart = false,
+                        bool addSpaceBefore = false);
+    void addMarker(const QString& marker);
+    void formatDecoded(const GidChunk& chunk, bool checksumOk);
+    template<bool Hex, bool HexForSpecialChars>
+    void formatData(const GidChunk& chunk, bool timestampAtStart,
+                    bool timestampAfterNewline);
+};
+
+#endif // GIDCONSOLEFORMATTER_H
@@ -0,0 +1,359 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidconsolesearch.h"
+
+#include <QElapsedTimer>
+#include <QScrollBar>
+#include <QTextBlock>
+
+#include <algorithm>
+
+
+GidConsoleSearch::GidConsoleSearch(QPlainTextEdit* edit, QObject *parent) :
+    QObject(parent),
+    edit(edit)
+{
+    connect(edit, &QPlainTextEdit::blockCountChanged,
+            this, &GidConsoleSearch::onBlockCountChanged);
+
+    indexTimer.setInterval(sliceMs * 2);
+    connect(&indexTimer, &QTimer::timeout, this, &GidConsoleSearch::indexSome);
+
+    highlightTimer.setSingleShot(true);
+    highlightTimer.setInterval(50);
+    connect(&highlightTimer, &QTimer::timeout,
+            this, &GidConsoleSearch::updateHighlights);
+    connect(edit->verticalScrollBar(), &QScrollBar::valueChanged, this, [=]()
+    {
+        if (mValid) { highlightTimer.start(); }
+    });
+}
+
+void GidConsoleSearch::setQuery(QString query, Mode mode)
+{
+    mMode = mode;
+    mNeedle.clear();
+    mNeedleTrigrams.clear();
+    mValid = false;
+    job.active = false;
+
+    if (query.isEmpty()) {
+        emit status("");
+        updateHighlights();
+        return;
+    }
+
+    if (mode == ModeText) {
+        mNeedle = query;
+    } else if (mode == ModeHex) {
+        // Hex bytes are searched for as they are displayed: two uppercase
+        // digits separated by spaces.
+        QString digits = query;
+        digits.remove(QRegularExpression("0[xX]"));
+        digits.remove(QRegularExpression("[\\s,]"));
+        bool ok = ((digits.length() % 2) == 0);
+        QStringList bytes;
+        for (int i = 0; ok && (i < digits.length()); i += 2) {
+            digits.mid(i, 2).toInt(&ok, 16);
+            bytes.append(digits.mid(i, 2).toUpper());
+        }
+        if (!ok) {
+            emit status("Invalid hex bytes");
+            updateHighlights();
+            return;
+        }
+        mNeedle = bytes.join(" ");
+    } else {
+        mRegex.setPattern(query);
+        mRegex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        if (!mRegex.isValid()) {
+            emit status("Invalid regex: " + mRegex.errorString());
+            updateHighlights();
+            return;
+        }
+        mRegex.optimize();
+    }
+
+    QString lower = mNeedle.toLower();
+    for (int i = 0; i + 2 < lower.length(); i++) {
+        mNeedleTrigrams.append(trigramHash(lower[i], lower[i+1], lower[i+2]));
+    }
+    mValid = true;
+
+    // Incremental search: the current match may be extended by the new query
+    startSearch(edit->textCursor().selectionStart(), false);
+    highlightTimer.start();
+}
+
+void GidConsoleSearch::findNext()
+{
+    if (!mValid) { return; }
+    startSearch(edit->textCursor().selectionEnd(), false);
+}
+
+void GidConsoleSearch::findPrevious()
+{
+    if (!mValid) { return; }
+    startSearch(edit->textCursor().selectionStart(), true);
+}
+
+void GidConsoleSearch::cancel()
+{
+    job.active = false;
+    mValid = false;
+    edit->setExtraSelections({});
+}
+
+void GidConsoleSearch::onBlockCountChanged(int count)
+{
+    // The document is only appended to. Fewer blocks means it was cleared.
+    if (count - 1 < indexedGroups * blocksPerGroup) {
+        blooms.clear();
+        indexedGroups = 0;
+        job.active = false;
+        edit->setExtraSelections({});
+    }
+
+    if (!indexTimer.isActive()) { indexTimer.start(); }
+    if (mValid && !highlightTimer.isActive()) { highlightTimer.start(); }
+}
+
+void GidConsoleSearch::indexSome()
+{
+    QTextDocument* doc = edit->document();
+
+    // Only groups of which all blocks are complete are indexed. The last block
+    // may still be appended to.
+    int completeGroups = (doc->blockCount() - 1) / blocksPerGroup;
+
+    QElapsedTimer timer;
+    timer.start();
+    while ((indexedGroups < completeGroups) && (timer.elapsed() < sliceMs)) {
+        blooms.resize((indexedGroups + 1) * bloomWords);
+        quint64* bloom = blooms.data() + indexedGroups * bloomWords;
+        std::fill(bloom, bloom + bloomWords, 0);
+
+        QTextBlock block = doc->findBlockByNumber(indexedGroups * blocksPerGroup);
+        for (int i = 0; (i < blocksPerGroup) && block.isValid(); i++) {
+            QString text = block.text().toLower();
+            const QChar* c = text.constData();
+            for (int j = 0; j + 2 < text.length(); j++) {
+                setBloomBits(bloom, trigramHash(c[j], c[j+1], c[j+2]));
+            }
+            block = block.next();
+        }
+        indexedGroups++;
+    }
+
+    if (indexedGroups >= completeGroups) { indexTimer.stop(); }
+}
+
+uint GidConsoleSearch::trigramHash(QChar a, QChar b, QChar c)
+{
+    uint h = (uint(a.unicode()) << 16) ^ (uint(b.unicode()) << 8) ^ c.unicode();
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+void GidConsoleSearch::setBloomBits(quint64* bloom, uint hash)
+{
+    // Two bits per trigram from different parts of the hash
+    uint bit1 = hash & (bloomWords * 64 - 1);
+    uint bit2 = (hash >> 16) & (bloomWords * 64 - 1);
+    bloom[bit1 / 64] |= quint64(1) << (bit1 % 64);
+    bloom[bit2 / 64] |= quint64(1) << (bit2 % 64);
+}
+
+bool GidConsoleSearch::testBloomBits(const quint64* bloom, uint hash)
+{
+    uint bit1 = hash & (bloomWords * 64 - 1);
+    uint bit2 = (hash >> 16) & (bloomWords * 64 - 1);
+    return (bloom[bit1 / 64] & (quint64(1) << (bit1 % 64)))
+        && (bloom[bit2 / 64] & (quint64(1) << (bit2 % 64)));
+}
+
+bool GidConsoleSearch::groupMayMatch(int group)
+{
+    if (group >= indexedGroups) { return true; }
+    const quint64* bloom = blooms.constData() + group * bloomWords;
+    foreach (uint h, mNeedleTrigrams) {
+        if (!testBloomBits(bloom, h)) { return false; }
+    }
+    return true;
+}
+
+/* Find a match in text. Forward searches for the first match starting at or
+ * after from. Backward searches for the last match starting before from, where
+ * from = -1 means the end of the text. Empty regex matches are ignored. */
+bool GidConsoleSearch::matchInBlock(const QString& text, int from, bool backward,
+                                    int* start, int* length)
+{
+    if (mMode == ModeRegex) {
+        bool found = false;
+        QRegularExpressionMatchIterator it = mRegex.globalMatch(
+                    text, backward ? 0 : from);
+        while (it.hasNext()) {
+            QRegularExpressionMatch m = it.next();
+            if (m.capturedLength() == 0) { continue; }
+            if (backward && (from >= 0) && (m.capturedStart() >= from)) { break; }
+            *start = m.capturedStart();
+            *length = m.capturedLength();
+            found = true;
+            if (!backward) { break; }
+        }
+        return found;
+    }
+
+    int i;
+    if (backward) {
+        if (from == 0) { return false; }
+        i = text.lastIndexOf(mNeedle, (from < 0) ? -1 : from - 1,
+                             Qt::CaseInsensitive);
+    } else {
+        i = text.indexOf(mNeedle, from, Qt::CaseInsensitive);
+    }
+    if (i < 0) { return false; }
+    *start = i;
+    *length = mNeedle.length();
+    return true;
+}
+
+void GidConsoleSearch::startSearch(int position, bool backward)
+{
+    QTextBlock block = edit->document()->findBlock(position);
+    job.id++;
+    job.active = true;
+    job.backward = backward;
+    job.block = block.blockNumber();
+    job.offset = position - block.position();
+    // Visit every block once, and the start block a second time after
+    // wrapping around for the part of it that was not searched yet.
+    job.remaining = edit->document()->blockCount() + 1;
+    continueSearch();
+}
+
+void GidConsoleSearch::continueSearch()
+{
+    if (!job.active) { return; }
+
+    QTextDocument* doc = edit->document();
+    int blockCount = doc->blockCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    while (job.remaining > 0) {
+
+        if ((job.remaining % 32 == 0) && (timer.elapsed() > sliceMs)) {
+            // Continue later so the GUI stays responsive
+            int id = job.id;
+            QTimer::singleShot(0, this, [=]()
+            {
+                if (job.id == id) { continueSearch(); }
+            });
+            emit status("Searching...");
+            return;
+        }
+
+        if (job.block >= blockCount) { job.block = 0; job.offset = 0; }
+        if (job.block < 0) { job.block = blockCount - 1; job.offset = -1; }
+
+        int group = job.block / blocksPerGroup;
+        if (!groupMayMatch(group)) {
+            // Skip the rest of the group
+            int next;
+            if (job.backward) {
+                next = group * blocksPerGroup - 1;
+                job.remaining -= job.block - next;
+            } else {
+                next = (group + 1) * blocksPerGroup;
+                job.remaining -= next - job.block;
+            }
+            job.block = next;
+            job.offset = job.backward ? -1 : 0;
+            continue;
+        }
+
+        QTextBlock block = doc->findBlockByNumber(job.block);
+        int start = 0;
+        int length = 0;
+        if (matchInBlock(block.text(), job.offset, job.backward, &start, &length)) {
+            job.active = false;
+            QTextCursor c(doc);
+            c.setPosition(block.position() + start);
+            c.setPosition(block.position() + start + length, QTextCursor::KeepAnchor);
+            edit->setTextCursor(c);
+            edit->ensureCursorVisible();
+            emit status(QString("Line %1").arg(job.block + 1));
+            highlightTimer.start();
+            return;
+        }
+
+        job.remaining--;
+        if (job.backward) {
+            job.block--;
+            job.offset = -1;
+        } else {
+            job.block++;
+            job.offset = 0;
+        }
+    }
+
+    job.active = false;
+    emit status("Not found");
+}
+
+void GidConsoleSearch::updateHighlights()
+{
+    QList<QTextEdit::ExtraSelection> selections;
+
+    if (mValid) {
+        QTextCharFormat format;
+        format.setBackground(QColor(255, 230, 100));
+
+        QTextBlock block = edit->cursorForPosition(QPoint(0, 0)).block();
+        QTextBlock last = edit->cursorForPosition(
+                    QPoint(0, edit->viewport()->height())).block();
+        while (block.isValid()) {
+            QString text = block.text();
+            int from = 0;
+            int start = 0;
+            int length = 0;
+            while (matchInBlock(text, from, false, &start, &length)) {
+                QTextEdit::ExtraSelection s;
+                s.cursor = QTextCursor(block);
+                s.cursor.setPosition(block.position() + start);
+                s.cursor.setPosition(block.position() + start + length,
+                                     QTextCursor::KeepAnchor);
+                s.format = format;
+                selections.append(s);
+                from = start + length;
+            }
+            if (block == last) { break; }
+            block = block.next();
+        }
+    }
+
+    edit->setExtraSelections(selections);
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDCONSOLESEARCH_H
+#define GIDCONSOLESEARCH_H
+
+#include <QObject>
+#include <QPlainTextEdit>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QVector>
+
+/* GidConsoleSearch provides incremental find in a QPlainTextEdit that is only
+ * ever appended to (or cleared), such as the console.
+ *
+ * Blocks are indexed in groups of blocksPerGroup. Each group has a bloom filter
+ * of the case-folded character trigrams in its blocks. Text and hex queries
+ * skip groups that cannot contain all the trigrams of the query, so only a
+ * small part of a large scrollback is scanned. Regex queries are not filtered.
+ *
+ * Indexing and searching are done on the GUI thread (a QTextDocument may not
+ * be accessed from another thread) in short time slices, so the GUI stays
+ * responsive while a large document is indexed or searched.
+ *
+ * Matches in the visible part of the document are highlighted. */
+class GidConsoleSearch : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode { ModeText, ModeHex, ModeRegex };
+
+    explicit GidConsoleSearch(QPlainTextEdit* edit, QObject *parent = 0);
+
+    // Set the query and search forward from the start of the current match.
+    void setQuery(QString query, Mode mode);
+    void findNext();
+    void findPrevious();
+    // Stop searching and remove highlights
+    void cancel();
+
+signals:
+    void status(QString msg);
+
+private:
+    QPlainTextEdit* edit = nullptr;
+
+    // Index
+    static const int blocksPerGroup = 64;
+    static const int bloomWords = 128; // 8192 bits
+    static const int sliceMs = 10;
+    QVector<quint64> blooms;
+    int indexedGroups = 0;
+    QTimer indexTimer;
+    void onBlockCountChanged(int count);
+    void indexSome();
+    static uint trigramHash(QChar a, QChar b, QChar c);
+    static void setBloomBits(quint64* bloom, uint hash);
+    static bool testBloomBits(const quint64* bloom, uint hash);
+    bool groupMayMatch(int group);
+
+    // Query
+    Mode mMode = ModeText;
+    QString mNeedle;
+    QRegularExpression mRegex;
+    QVector<uint> mNeedleTrigrams;
+    bool mValid = false;
+    bool matchInBlock(const QString& text, int from, bool backward,
+                      int* start, int* length);
+
+    // Search job
+    struct Job {
+        int id = 0;
+        bool active = false;
+        bool backward = false;
+        int block = 0;
+        int offset = 0;
+        int remaining = 0;
+    } job;
+    void startSearch(int position, bool backward);
+    void continueSearch();
+
+    // Highlighting of visible matches
+    QTimer highlightTimer;
+    void updateHighlights();
+};
+
+#endif // GIDCONSOLESEARCH_H
@@ -62,6 +62,25 @@ void GidConsoleWidget::scrollToBottom()
     verticalScrollBar()->setValue(verticalScrollBar()->maximum());
 }
 
+void GidConsoleWidget::setFramePacing(bool enable)
+{
+    mFramePacing = enable;
+    if (!enable) { presentFrame(); }
+}
+
+void GidConsoleWidget::presentFrame()
+{
+    if (mScrollPending) {
+        mScrollPending = false;
+        scrollToBottom();
+    }
+    if (mRepaintPending) {
+        mRepaintPending = false;
+        // Re-enabling updates implicitly repaints the viewport
+        viewport()->setUpdatesEnabled(true);
+    }
+}
+
 bool GidConsoleWidget::cursorIsOnNewLine()
 {
     return (currentLineLength() == 0);
@@ -77,6 +96,16 @@ int GidConsoleWidget::currentLineLength()
     return mLineLength;
 }
 
+int GidConsoleWidget::lineChars()
+{
+    return mMaxLineChars;
+}
+
+int GidConsoleWidget::tabChars()
+{
+    return int(tabStopDistance() / mCharWidth) + 1;
+}
+
 void GidConsoleWidget::updateLineWidthInfo()
 {
     QFontMetricsF fm(this->font());
@@ -97,7 +126,9 @@ void GidConsoleWidget::resizeEvent(QResizeEvent* event)
 {
     QPlainTextEdit::resizeEvent(event);
 
+    int before = mMaxLineChars;
     updateLineWidthInfo();
+    if (mMaxLineChars != before) { emit lineCharsChanged(); }
 }
 
 void GidConsoleWidget::procressToPrint(ToPrint tp)
@@ -142,20 +173,8 @@ void GidConsoleWidget::process(ToPrint tp)
      * effect manual line wrapping.
      */
 
-    QColor color = tp.color;
     QString txt = tp.txt;
-
-    setCursorTextColor(color);
-
-    // Workaround for scrolling when widget is not full of text yet.
-    bool scroll;
-    if (mScrollInit) {
-        scroll = true;
-        if (verticalScrollBar()->maximum() > 0) { mScrollInit = false; }
-    } else {
-        scroll = (verticalScrollBar()->value() == verticalScrollBar()->maximum());
-    }
-
+    bool scroll = beginInsert(tp.color);
 
     int nWritten = 0;
     int readIndex = 0;
@@ -170,7 +189,7 @@ void GidConsoleWidget::process(ToPrint tp)
                 break;
             }
             if (txt.at(readIndex) == '\t') {
-                mLineLength += this->tabStopDistance() / mCharWidth + 1;
+                mLineLength += tabChars();
             } else {
                 mLineLength += 1;
             }
@@ -190,10 +209,61 @@ void GidConsoleWidget::process(ToPrint tp)
         }
     }
 
+    endInsert(scroll);
+}
+
+/* Text from GidConsoleFormatter already has newlines at the wrap points, so it
+ * is inserted as is. Only the length of its last line is counted. */
+void GidConsoleWidget::addWrappedText(const QString& txt, QColor color)
+{
+    bool scroll = beginInsert(color);
+    mCursor.insertText(txt);
+
+    int lastNewline = txt.lastIndexOf('\n');
+    if (lastNewline >= 0) { mLineLength = 0; }
+    int tab = tabChars();
+    for (int i = lastNewline + 1; i < txt.length(); i++) {
+        mLineLength += (txt.at(i) == '\t') ? tab : 1;
+    }
+
+    endInsert(scroll);
+}
+
+/* Sets the colour for inserted text and holds back repainting when frame
+ * pacing is on. Returns whether to scroll to the bottom after inserting. */
+bool GidConsoleWidget::beginInsert(QColor color)
+{
+    setCursorTextColor(color);
+
+    if (mFramePacing && !mRepaintPending) {
+        viewport()->setUpdatesEnabled(false);
+        mRepaintPending = true;
+    }
+
+    // Workaround for scrolling when widget is not full of text yet.
+    bool scroll;
+    if (mScrollInit) {
+        scroll = true;
+        if (verticalScrollBar()->maximum() > 0) { mScrollInit = false; }
+    } else {
+        // A deferred scroll means we were at the bottom before the previous
+        // text was added.
+        scroll = mScrollPending
+                 || (verticalScrollBar()->value() == verticalScrollBar()->maximum());
+    }
+    return scroll;
+}
+
+void GidConsoleWidget::endInsert(bool scroll)
+{
     mRemainingOnLine = mMaxLineChars - mLineLength;
 
     if (scroll && mAutoScroll) {
-        scrollToBottom();
+        if (mFramePacing) {
+            mScrollPending = true;
+        } else {
+            scrollToBottom();
+        }
     }
 }
 
@@ -37,15 +37,33 @@ public:
     void autoScroll(bool scroll);
     void scrollToBottom();
 
+    /* With frame pacing enabled, scrolling and repainting caused by added text
+     * are deferred until presentFrame() is called. This keeps the cost of
+     * displaying many small pieces of text independent of the refresh rate. */
+    void setFramePacing(bool enable);
+    void presentFrame();
+
+    // Adds text that is already wrapped to lineChars()
+    void addWrappedText(const QString& txt, QColor color = Qt::black);
+
     bool cursorIsOnNewLine();
     int remainingOnLine();
     int currentLineLength();
+    // Width of the console and of a tab in characters
+    int lineChars();
+    int tabChars();
+
+signals:
+    void lineCharsChanged();
 
 private:
     bool mScrollInit = true;
     QTextCursor mCursor;
     bool mAutoScroll = true;
     bool mLastWasNewline = false;
+    bool mFramePacing = false;
+    bool mScrollPending = false;
+    bool mRepaintPending = false;
 
     int mMaxLineChars = 80;
     int mLineLength = 0;
@@ -54,6 +72,8 @@ private:
     void updateLineWidthInfo();
 
     void setCursorTextColor(QColor color);
+    bool beginInsert(QColor color);
+    void endInsert(bool scroll);
 
     void resizeEvent(QResizeEvent* event);
 
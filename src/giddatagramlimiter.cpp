@@ -0,0 +1,116 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "giddatagramlimiter.h"
+
+
+namespace {
+
+// Bucket shared by senders beyond maxSenders
+const QString otherSenders = "other senders";
+
+} // namespace
+
+void GidDatagramLimiter::setRate(int perSecond)
+{
+    mRate = qMax(0, perSecond);
+}
+
+/* Buckets hold up to one second of datagrams, so short bursts within the rate
+ * are displayed in full. */
+bool GidDatagramLimiter::allow(const QString& sender, int bytes, qint64 nowUs)
+{
+    if (mRate == 0) { return true; }
+
+    auto it = mBuckets.find(sender);
+    if (it == mBuckets.end()) {
+        // Counts are only reported once per interval, so pruning more often
+        // would rarely free anything
+        if ((mBuckets.count() >= maxSenders)
+                && (nowUs - mLastPruneUs >= summaryIntervalUs)) {
+            mLastPruneUs = nowUs;
+            // Forget senders with nothing left to report
+            auto b = mBuckets.begin();
+            while (b != mBuckets.end()) {
+                if (b->suppressed == 0) {
+                    b = mBuckets.erase(b);
+                } else {
+                    ++b;
+                }
+            }
+        }
+        // If the table is still full, the new sender shares a bucket with
+        // other new senders, so a flood of (spoofed) addresses can't grow it
+        // without bound
+        const QString& key = (mBuckets.count() >= maxSenders) ? otherSenders
+                                                              : sender;
+        it = mBuckets.find(key);
+        if (it == mBuckets.end()) {
+            Bucket b;
+            b.tokens = mRate;
+            b.lastUs = nowUs;
+            b.lastSummaryUs = nowUs;
+            it = mBuckets.insert(key, b);
+        }
+    }
+
+    Bucket& b = it.value();
+    b.tokens = qMin(double(mRate), b.tokens + (nowUs - b.lastUs) * mRate / 1e6);
+    b.lastUs = nowUs;
+    if (b.tokens >= 1) {
+        b.tokens -= 1;
+        return true;
+    }
+    b.suppressed++;
+    b.suppressedBytes += bytes;
+    return false;
+}
+
+QList<GidDatagramLimiter::Summary> GidDatagramLimiter::takeSummaries(qint64 nowUs)
+{
+    QList<Summary> ret;
+    for (auto it = mBuckets.begin(); it != mBuckets.end(); ++it) {
+        Bucket& b = it.value();
+        if (b.suppressed == 0) { continue; }
+        if (nowUs - b.lastSummaryUs < summaryIntervalUs) { continue; }
+        ret.append({it.key(), b.suppressed, b.suppressedBytes});
+        b.suppressed = 0;
+        b.suppressedBytes = 0;
+        b.lastSummaryUs = nowUs;
+    }
+    return ret;
+}
+
+bool GidDatagramLimiter::takeSummary(const QString& sender, Summary* summary)
+{
+    auto it = mBuckets.find(sender);
+    if ((it == mBuckets.end()) || (it->suppressed == 0)) { return false; }
+    *summary = {sender, it->suppressed, it->suppressedBytes};
+    it->suppressed = 0;
+    it->suppressedBytes = 0;
+    it->lastSummaryUs = it->lastUs;
+    return true;
+}
+
+void GidDatagramLimiter::clear()
+{
+    mBuckets.clear();
+    mLastPruneUs = 0;
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDDATAGRAMLIMITER_H
+#define GIDDATAGRAMLIMITER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/* GidDatagramLimiter limits how many datagrams per second are displayed from
+ * each sender with a token bucket per sender, so one flooding sender doesn't
+ * crowd out the others. Datagrams that are not allowed are counted and
+ * reported as summaries instead. Beyond maxSenders, new senders share one
+ * bucket, reported as "other senders". */
+class GidDatagramLimiter
+{
+public:
+    struct Summary {
+        QString sender;
+        qint64 datagrams;
+        qint64 bytes;
+    };
+
+    // Datagrams per second per sender, 0 for no limit
+    void setRate(int perSecond);
+    bool allow(const QString& sender, int bytes, qint64 nowUs);
+    /* Suppressed counts of senders not reported in the last second, or of
+     * the given sender only. Reported counts are reset. */
+    QList<Summary> takeSummaries(qint64 nowUs);
+    bool takeSummary(const QString& sender, Summary* summary);
+    void clear();
+
+private:
+    static const int maxSenders = 4096;
+    static const qint64 summaryIntervalUs = 1000000;
+
+    struct Bucket {
+        double tokens = 0;
+        qint64 lastUs = 0;
+        qint64 suppressed = 0;
+        qint64 suppressedBytes = 0;
+        qint64 lastSummaryUs = 0;
+    };
+    QHash<QString, Bucket> mBuckets;
+    qint64 mLastPruneUs = 0;
+    int mRate = 0;
+};
+
+#endif // GIDDATAGRAMLIMITER_H
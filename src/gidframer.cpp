@@ -0,0 +1,197 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidframer.h"
+
+#include <cstring>
+
+
+int GidFramer::feed(const GidChunk& chunk, QList<GidChunk>& frames)
+{
+    int errors = 0;
+    mBuffer.append(chunk.data);
+    char* data = mBuffer.data();
+
+    while (mReadPos < mBuffer.count()) {
+        int len = mBuffer.count() - mReadPos;
+        Q_ASSERT(mScanned <= len);
+        Result r = parse(data + mReadPos, len, mScanned);
+
+        if (r.consumed == 0) {
+            // Incomplete. Continue scanning from here when more data arrives.
+            mScanned = len;
+            if (len > mMaxFrameSize) {
+                // Discard the data and start scanning afresh
+                errors++;
+                mReadPos = mBuffer.count();
+                mScanned = 0;
+            }
+            break;
+        }
+
+        if (r.frameLength < 0) {
+            errors++;
+        } else if (r.frameLength > 0) {
+            GidChunk frame(QByteArray(data + mReadPos + r.frameStart, r.frameLength),
+                           chunk.timestamp, true);
+            frames.append(frame);
+        }
+        mReadPos += r.consumed;
+        mScanned = 0;
+    }
+
+    // Remove consumed bytes once
+    if (mReadPos == mBuffer.count()) {
+        mBuffer.clear();
+    } else if (mReadPos > 0) {
+        mBuffer.remove(0, mReadPos);
+    }
+    mReadPos = 0;
+
+    return errors;
+}
+
+void GidFramer::reset()
+{
+    mBuffer.clear();
+    mReadPos = 0;
+    mScanned = 0;
+}
+
+GidDelimiterFramer::GidDelimiterFramer(QByteArray delimiter, bool keepDelimiter) :
+    mMatcher(delimiter),
+    mDelimiterLength(delimiter.count()),
+    mKeepDelimiter(keepDelimiter)
+{
+}
+
+GidFramer::Result GidDelimiterFramer::parse(char* data, int len, int scanned)
+{
+    Result r;
+    if (mDelimiterLength == 0) { return r; }
+
+    // A delimiter may have started in the last bytes scanned before
+    int from = qMax(0, scanned - mDelimiterLength + 1);
+    int i = mMatcher.indexIn(data, len, from);
+    if (i < 0) { return r; }
+
+    r.consumed = i + mDelimiterLength;
+    r.frameLength = mKeepDelimiter ? r.consumed : i;
+    return r;
+}
+
+GidLengthPrefixFramer::GidLengthPrefixFramer(int lengthOffset, int lengthSize,
+                                             bool bigEndian,
+                                             bool lengthIncludesHeader) :
+    mLengthOffset(lengthOffset),
+    mLengthSize(lengthSize),
+    mBigEndian(bigEndian),
+    mLengthIncludesHeader(lengthIncludesHeader)
+{
+}
+
+GidFramer::Result GidLengthPrefixFramer::parse(char* data, int len, int /*scanned*/)
+{
+    Result r;
+    int headerLength = mLengthOffset + mLengthSize;
+    if (len < headerLength) { return r; }
+
+    const uchar* field = reinterpret_cast<const uchar*>(data + mLengthOffset);
+    quint64 value = 0;
+    for (int i = 0; i < mLengthSize; i++) {
+        int shift = mBigEndian ? (mLengthSize - 1 - i) * 8 : i * 8;
+        value |= quint64(field[i]) << shift;
+    }
+    quint64 total = mLengthIncludesHeader ? value : value + headerLength;
+
+    if ((total < quint64(headerLength)) || (total > quint64(maxFrameSize()))) {
+        // Not a valid header. Skip a byte to find the next one.
+        r.consumed = 1;
+        r.frameLength = -1;
+        return r;
+    }
+    if (quint64(len) < total) { return r; }
+
+    r.consumed = int(total);
+    r.frameLength = int(total);
+    return r;
+}
+
+GidFramer::Result GidSlipFramer::parse(char* data, int len, int scanned)
+{
+    const char END = char(0xC0);
+    const char ESC = char(0xDB);
+    const char ESC_END = char(0xDC);
+    const char ESC_ESC = char(0xDD);
+
+    Result r;
+    const char* end = static_cast<const char*>(
+                std::memchr(data + scanned, END, len - scanned));
+    if (!end) { return r; }
+    int n = end - data;
+    r.consumed = n + 1;
+
+    // Decode in place. The decoded frame is never longer than the encoded one.
+    int w = 0;
+    for (int i = 0; i < n; i++) {
+        char c = data[i];
+        if (c == ESC) {
+            i++;
+            if (i == n) { r.frameLength = -1; return r; }
+            if (data[i] == ESC_END) {
+                c = END;
+            } else if (data[i] == ESC_ESC) {
+                c = ESC;
+            } else {
+                r.frameLength = -1;
+                return r;
+            }
+        }
+        data[w++] = c;
+    }
+    // Empty frames (e.g. a leading END) are ignored
+    r.frameLength = w;
+    return r;
+}
+
+GidFramer::Result GidCobsFramer::parse(char* data, int len, int scanned)
+{
+    Result r;
+    const char* end = static_cast<const char*>(
+                std::memchr(data + scanned, 0, len - scanned));
+    if (!end) { return r; }
+    int n = end - data;
+    r.consumed = n + 1;
+
+    // Decode in place. Each code byte is replaced by at most one zero byte,
+    // so writing never overtakes reading.
+    int w = 0;
+    int i = 0;
+    while (i < n) {
+        int code = uchar(data[i++]);
+        if (i + code - 1 > n) { r.frameLength = -1; return r; }
+        for (int j = 1; j < code; j++) {
+            data[w++] = data[i++];
+        }
+        if ((code != 0xFF) && (i < n)) { data[w++] = 0; }
+    }
+    r.frameLength = w;
+    return r;
+}
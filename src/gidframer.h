@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDFRAMER_H
+#define GIDFRAMER_H
+
+#include "gidchunk.h"
+
+#include <QByteArray>
+#include <QByteArrayMatcher>
+#include <QList>
+
+/* GidFramer reassembles frames from a stream of chunks. Data is appended to a
+ * receive buffer and parse() of the subclass is called to find frames in it.
+ * Bytes that were already scanned without finding the end of a frame are not
+ * scanned again when more data arrives. Escaped frames (SLIP, COBS) are decoded
+ * in place in the receive buffer, and consumed bytes are only removed from the
+ * buffer once per feed() instead of once per frame.
+ *
+ * A frame gets the timestamp of the chunk that completed it. */
+class GidFramer
+{
+public:
+    virtual ~GidFramer() {}
+
+    /* Append the frames completed by chunk to frames. Returns the number of
+     * invalid or oversized frames that were discarded. */
+    int feed(const GidChunk& chunk, QList<GidChunk>& frames);
+    void reset();
+
+    // Incomplete frames that grow beyond this are discarded
+    void setMaxFrameSize(int size) { mMaxFrameSize = size; }
+    int maxFrameSize() const { return mMaxFrameSize; }
+    // Number of bytes waiting for the rest of a frame
+    int pendingBytes() const { return mBuffer.count() - mReadPos; }
+
+protected:
+    struct Result {
+        // Bytes consumed from the start of data. 0 if no frame is complete.
+        int consumed = 0;
+        // Position and length of the frame in data after decoding. A length
+        // of -1 means the consumed bytes were an invalid frame.
+        int frameStart = 0;
+        int frameLength = 0;
+    };
+    /* Find the first frame in data, which has length len. The first scanned
+     * bytes of data were already searched on a previous call. */
+    virtual Result parse(char* data, int len, int scanned) = 0;
+
+private:
+    QByteArray mBuffer;
+    int mReadPos = 0;
+    int mScanned = 0;
+    int mMaxFrameSize = 65536;
+};
+
+/* Frames end with a delimiter sequence, e.g. "\r\n". */
+class GidDelimiterFramer : public GidFramer
+{
+public:
+    GidDelimiterFramer(QByteArray delimiter, bool keepDelimiter);
+protected:
+    Result parse(char* data, int len, int scanned) override;
+private:
+    QByteArrayMatcher mMatcher;
+    int mDelimiterLength;
+    bool mKeepDelimiter;
+};
+
+/* Frames start with a header that contains the length. The length field of
+ * lengthSize bytes (1, 2 or 4) follows lengthOffset other header bytes. The
+ * length either counts the whole frame, or only the bytes after the header. */
+class GidLengthPrefixFramer : public GidFramer
+{
+public:
+    GidLengthPrefixFramer(int lengthOffset, int lengthSize, bool bigEndian,
+                          bool lengthIncludesHeader);
+protected:
+    Result parse(char* data, int len, int scanned) override;
+private:
+    int mLengthOffset;
+    int mLengthSize;
+    bool mBigEndian;
+    bool mLengthIncludesHeader;
+};
+
+/* SLIP (RFC 1055): frames end with 0xC0, with 0xC0 and 0xDB escaped. */
+class GidSlipFramer : public GidFramer
+{
+protected:
+    Result parse(char* data, int len, int scanned) override;
+};
+
+/* Consistent Overhead Byte Stuffing: frames end with 0x00, which does not
+ * occur in the encoded frame. */
+class GidCobsFramer : public GidFramer
+{
+protected:
+    Result parse(char* data, int len, int scanned) override;
+};
+
+#endif // GIDFRAMER_H
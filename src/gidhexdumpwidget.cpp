@@ -0,0 +1,239 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidhexdumpwidget.h"
+
+#include "Utilities.h"
+
+#include <QPainter>
+#include <QScrollBar>
+
+#include <algorithm>
+#include <climits>
+
+
+GidHexDumpWidget::GidHexDumpWidget(QWidget *parent) :
+    QAbstractScrollArea(parent)
+{
+    setFont(Utilities::getMonospaceFont());
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    updateScrollBars();
+}
+
+void GidHexDumpWidget::append(const QByteArray& data, bool sent)
+{
+    if (data.isEmpty()) { return; }
+
+    if (sent) {
+        if (!sentRanges.isEmpty() && (sentRanges.last().end == mSize)) {
+            sentRanges.last().end += data.count();
+        } else {
+            sentRanges.append({mSize, mSize + data.count()});
+        }
+    }
+
+    const char* src = data.constData();
+    int remaining = data.count();
+    while (remaining > 0) {
+        if (blocks.isEmpty() || (blocks.last().count() == blockSize)) {
+            blocks.append(QByteArray());
+            blocks.last().reserve(blockSize);
+        }
+        QByteArray& block = blocks.last();
+        int n = qMin(remaining, blockSize - block.count());
+        block.append(src, n);
+        src += n;
+        remaining -= n;
+    }
+    mSize += data.count();
+
+    mDirty = true;
+}
+
+void GidHexDumpWidget::clear()
+{
+    blocks.clear();
+    sentRanges.clear();
+    mSize = 0;
+    updateScrollBars();
+    viewport()->update();
+}
+
+void GidHexDumpWidget::setBytesPerRow(int n)
+{
+    if (n == mBytesPerRow) { return; }
+
+    // Keep the byte at the top of the view in view
+    qint64 topByte = qint64(verticalScrollBar()->value()) * mBytesPerRow;
+    mBytesPerRow = n;
+    updateScrollBars();
+    verticalScrollBar()->setValue(topByte / mBytesPerRow);
+    viewport()->update();
+}
+
+void GidHexDumpWidget::setAutoScroll(bool scroll)
+{
+    mAutoScroll = scroll;
+    if (mAutoScroll) { scrollToBottom(); }
+}
+
+void GidHexDumpWidget::scrollToBottom()
+{
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+}
+
+void GidHexDumpWidget::presentFrame()
+{
+    if (!mDirty) { return; }
+    mDirty = false;
+
+    updateScrollBars();
+    if (mAutoScroll) { scrollToBottom(); }
+    viewport()->update();
+}
+
+char GidHexDumpWidget::byteAt(qint64 i) const
+{
+    return blocks.at(i >> blockBits).at(i & (blockSize - 1));
+}
+
+int GidHexDumpWidget::offsetDigits() const
+{
+    // At least 8 digits, more when needed
+    int digits = 8;
+    while ((digits < 16) && ((mSize >> (digits * 4)) > 0)) { digits++; }
+    return digits;
+}
+
+int GidHexDumpWidget::rowChars() const
+{
+    // Offset, two spaces, hex bytes separated by spaces with an extra space
+    // between groups of 8, two spaces, ASCII.
+    return offsetDigits() + 2 + (mBytesPerRow * 3) + (mBytesPerRow / 8)
+            + mBytesPerRow;
+}
+
+qint64 GidHexDumpWidget::rowCount() const
+{
+    return (mSize + mBytesPerRow - 1) / mBytesPerRow;
+}
+
+void GidHexDumpWidget::updateScrollBars()
+{
+    QFontMetrics fm(font());
+    int lineHeight = fm.height();
+    int visibleRows = qMax(1, viewport()->height() / lineHeight);
+
+    qint64 maxRow = qMax(qint64(0), rowCount() - visibleRows);
+    verticalScrollBar()->setRange(0, int(qMin(maxRow, qint64(INT_MAX))));
+    verticalScrollBar()->setPageStep(visibleRows);
+
+    int width = fm.horizontalAdvance(QChar('0')) * (rowChars() + 1);
+    horizontalScrollBar()->setRange(0, qMax(0, width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+}
+
+void GidHexDumpWidget::paintEvent(QPaintEvent* /*event*/)
+{
+    QPainter p(viewport());
+    p.setFont(font());
+
+    QFontMetrics fm(font());
+    int lineHeight = fm.height();
+    int charWidth = fm.horizontalAdvance(QChar('0'));
+    int x0 = charWidth / 2 - horizontalScrollBar()->value();
+
+    QColor receivedColor = palette().color(QPalette::Text);
+    QColor sentColor = Qt::darkGreen;
+    QColor offsetColor = Qt::gray;
+
+    int digits = offsetDigits();
+    int hexStart = digits + 2;
+    int asciiStart = hexStart + (mBytesPerRow * 3) + (mBytesPerRow / 8);
+
+    qint64 firstRow = verticalScrollBar()->value();
+    qint64 lastRow = qMin(rowCount(), firstRow + viewport()->height() / lineHeight + 1);
+
+    // First sent range that may contain bytes of the first visible row
+    qint64 firstByte = firstRow * mBytesPerRow;
+    int rangeIndex = std::lower_bound(sentRanges.constBegin(), sentRanges.constEnd(),
+                                      firstByte, [](const Range& r, qint64 i)
+    {
+        return r.end <= i;
+    }) - sentRanges.constBegin();
+
+    static const char hexDigits[] = "0123456789ABCDEF";
+
+    for (qint64 row = firstRow; row < lastRow; row++) {
+        int y = int(row - firstRow) * lineHeight + fm.ascent();
+        qint64 rowStart = row * mBytesPerRow;
+        int n = int(qMin(qint64(mBytesPerRow), mSize - rowStart));
+
+        p.setPen(offsetColor);
+        p.drawText(x0, y, QString("%1").arg(rowStart, digits, 16, QChar('0')).toUpper());
+
+        // Draw runs of bytes with the same direction in one go
+        int j = 0;
+        while (j < n) {
+            qint64 i = rowStart + j;
+            while ((rangeIndex < sentRanges.count())
+                   && (sentRanges.at(rangeIndex).end <= i)) {
+                rangeIndex++;
+            }
+            bool sent = (rangeIndex < sentRanges.count())
+                        && (sentRanges.at(rangeIndex).start <= i);
+            int runEnd;
+            if (sent) {
+                runEnd = int(qMin(qint64(n), sentRanges.at(rangeIndex).end - rowStart));
+            } else if (rangeIndex < sentRanges.count()) {
+                runEnd = int(qMin(qint64(n), sentRanges.at(rangeIndex).start - rowStart));
+            } else {
+                runEnd = n;
+            }
+
+            QString hex;
+            QString ascii;
+            for (int k = j; k < runEnd; k++) {
+                uchar c = uchar(byteAt(rowStart + k));
+                if (k > j) {
+                    hex += ' ';
+                    if ((k % 8) == 0) { hex += ' '; }
+                }
+                hex += QChar(hexDigits[c >> 4]);
+                hex += QChar(hexDigits[c & 0xF]);
+                ascii += ((c >= 0x20) && (c < 0x7F)) ? QChar(c) : QChar('.');
+            }
+
+            p.setPen(sent ? sentColor : receivedColor);
+            p.drawText(x0 + charWidth * (hexStart + j * 3 + j / 8), y, hex);
+            p.drawText(x0 + charWidth * (asciiStart + j), y, ascii);
+
+            j = runEnd;
+        }
+    }
+}
+
+void GidHexDumpWidget::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    bool atBottom = (verticalScrollBar()->value() == verticalScrollBar()->maximum());
+    updateScrollBars();
+    if (mAutoScroll && atBottom) { scrollToBottom(); }
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDHEXDUMPWIDGET_H
+#define GIDHEXDUMPWIDGET_H
+
+#include <QAbstractScrollArea>
+#include <QByteArray>
+#include <QVector>
+
+/* GidHexDumpWidget shows data as a classic hex dump:
+ *
+ *     00000010  48 65 6C 6C 6F 0D 0A 00  01 02 03 04 05 06 07 08  Hello...........
+ *
+ * The raw bytes are kept in fixed size blocks and rows are only formatted when
+ * they are painted, so the cost of adding data does not depend on how it is
+ * displayed and large amounts of data can be browsed.
+ *
+ * Sent bytes are remembered as ranges and drawn in a different color.
+ *
+ * Like GidConsoleWidget with frame pacing, appended data is only shown (and
+ * scrolled to) when presentFrame() is called. */
+class GidHexDumpWidget : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    explicit GidHexDumpWidget(QWidget *parent = 0);
+
+    void append(const QByteArray& data, bool sent);
+    void clear();
+    qint64 size() const { return mSize; }
+
+    void setBytesPerRow(int n);
+    int bytesPerRow() const { return mBytesPerRow; }
+
+    void setAutoScroll(bool scroll);
+    void scrollToBottom();
+    void presentFrame();
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    static const int blockBits = 20; // 1 MiB blocks
+    static const int blockSize = 1 << blockBits;
+    QVector<QByteArray> blocks;
+    qint64 mSize = 0;
+    char byteAt(qint64 i) const;
+
+    // Sorted, non-overlapping ranges [start, end) of sent bytes
+    struct Range { qint64 start; qint64 end; };
+    QVector<Range> sentRanges;
+
+    int mBytesPerRow = 16;
+    bool mAutoScroll = true;
+    bool mDirty = false;
+
+    int offsetDigits() const;
+    int rowChars() const;
+    qint64 rowCount() const;
+    void updateScrollBars();
+};
+
+#endif // GIDHEXDUMPWIDGET_H
@@ -0,0 +1,250 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidlatencyprobe.h"
+
+#include <QFile>
+#include <QtAlgorithms>
+
+#include <cmath>
+
+
+namespace {
+
+int msb(quint64 v)
+{
+    return 63 - qCountLeadingZeroBits(v);
+}
+
+} // namespace
+
+GidLatencyHistogram::GidLatencyHistogram()
+{
+    mCounts.fill(0, (maxBits - subBits + 1) * subCount);
+}
+
+/* Values below 2 * subCount have a bucket each. Above that, each power of two
+ * is split into subCount buckets. */
+int GidLatencyHistogram::bucketIndex(qint64 us)
+{
+    if (us < 2 * subCount) { return int(qMax(qint64(0), us)); }
+    us = qMin(us, (qint64(1) << maxBits) - 1);
+    int shift = msb(us) - subBits;
+    return (shift + 1) * subCount + int((us >> shift) - subCount);
+}
+
+qint64 GidLatencyHistogram::bucketLowest(int index)
+{
+    if (index < 2 * subCount) { return index; }
+    int shift = index / subCount - 1;
+    return qint64(index % subCount + subCount) << shift;
+}
+
+void GidLatencyHistogram::record(qint64 us)
+{
+    mCounts[bucketIndex(us)]++;
+    if (mCount == 0) {
+        mMin = us;
+        mMax = us;
+    } else {
+        mMin = qMin(mMin, us);
+        mMax = qMax(mMax, us);
+    }
+    mCount++;
+    mSum += us;
+}
+
+void GidLatencyHistogram::clear()
+{
+    mCounts.fill(0);
+    mCount = 0;
+    mSum = 0;
+    mMin = 0;
+    mMax = 0;
+}
+
+qint64 GidLatencyHistogram::percentile(double p) const
+{
+    if (mCount == 0) { return 0; }
+    qint64 target = qMax(qint64(1), qint64(std::ceil(p / 100.0 * mCount)));
+    qint64 cumulative = 0;
+    for (int i = 0; i < mCounts.count(); i++) {
+        cumulative += mCounts.at(i);
+        if (cumulative >= target) {
+            // Highest value in the bucket, but never above the actual maximum
+            return qMin(bucketLowest(i + 1) - 1, mMax);
+        }
+    }
+    return mMax;
+}
+
+QVector<qint64> GidLatencyHistogram::octaveCounts(int bitsFrom) const
+{
+    QVector<qint64> ret;
+    if (mCount == 0) { return ret; }
+    ret.fill(0, qMax(0, msb(quint64(qMax(mMax, qint64(1)))) - bitsFrom) + 1);
+    for (int i = 0; i < mCounts.count(); i++) {
+        if (mCounts.at(i) == 0) { continue; }
+        qint64 v = bucketLowest(i);
+        int octave = (v == 0) ? 0 : msb(quint64(v));
+        int k = qBound(0, octave - bitsFrom, ret.count() - 1);
+        ret[k] += mCounts.at(i);
+    }
+    return ret;
+}
+
+bool GidLatencyProbe::setResponsePattern(QString pattern)
+{
+    mRegex.setPattern(pattern);
+    mText.clear();
+    if (!mRegex.isValid()) { return false; }
+    mRegex.optimize();
+    return true;
+}
+
+QByteArray GidLatencyProbe::nextRequest(const GidTimestamp& sent)
+{
+    quint32 seq = mSeq++;
+    mPending.append({seq, sent});
+    mSent++;
+    return QString(mRequest).replace("{seq}", QString::number(seq)).toLocal8Bit();
+}
+
+int GidLatencyProbe::feed(const GidChunk& chunk)
+{
+    if (!mRegex.isValid()) { return 0; }
+
+    mText.append(QString::fromLatin1(chunk.data));
+    mTextTimestamp = chunk.timestamp;
+    return matchResponses(true);
+}
+
+/* Matches responses in the received text. If waitForMore is set and the text
+ * ends with the start of a possible match, matching stops there until more
+ * data is received, so e.g. "PONG 1" is not taken as a response while "2" of
+ * "PONG 12" is still underway. */
+int GidLatencyProbe::matchResponses(bool waitForMore)
+{
+    int n = 0;
+    int offset = 0;
+    QRegularExpression::MatchType type = waitForMore
+            ? QRegularExpression::PartialPreferFirstMatch
+            : QRegularExpression::NormalMatch;
+    while (offset < mText.length()) {
+        QRegularExpressionMatch m = mRegex.match(mText, offset, type);
+        if (m.hasPartialMatch()) {
+            offset = m.capturedStart(0);
+            break;
+        }
+        if (!m.hasMatch()) {
+            // Nothing that is left can be the start of a response
+            offset = mText.length();
+            break;
+        }
+        respond(m);
+        n++;
+        offset = qMax(m.capturedEnd(0), offset + 1);
+    }
+    mText.remove(0, qMin(offset, mText.length()));
+    if (mText.length() > maxTextLength) {
+        mText.remove(0, mText.length() - maxTextLength);
+    }
+    return n;
+}
+
+void GidLatencyProbe::respond(const QRegularExpressionMatch& m)
+{
+    int index = -1;
+    if (mRegex.captureCount() >= 1) {
+        bool ok = false;
+        quint32 seq = m.capturedRef(1).toUInt(&ok);
+        for (int i = 0; ok && (i < mPending.count()); i++) {
+            if (mPending.at(i).seq == seq) { index = i; break; }
+        }
+    } else if (!mPending.isEmpty()) {
+        index = 0;
+    }
+
+    if (index < 0) {
+        // Response to a request that timed out, or not a response at all
+        mUnmatched++;
+        return;
+    }
+    Pending p = mPending.takeAt(index);
+    addSample(p, p.sent.usecsTo(mTextTimestamp));
+}
+
+void GidLatencyProbe::expire(const GidTimestamp& now)
+{
+    // A response at the very end of the received text has waited long enough
+    if (!mText.isEmpty() && mRegex.isValid()) { matchResponses(false); }
+
+    while (!mPending.isEmpty() && (mPending.first().sent.usecsTo(now) > mTimeoutUs)) {
+        addSample(mPending.takeFirst(), -1);
+        mLost++;
+    }
+}
+
+void GidLatencyProbe::addSample(const Pending& p, qint64 rttUs)
+{
+    if (rttUs >= 0) { mHistogram.record(rttUs); }
+    if (mSamples.count() < maxSamples) {
+        mSamples.append({p.seq, p.sent, rttUs});
+    }
+}
+
+void GidLatencyProbe::clear()
+{
+    mPending.clear();
+    mText.clear();
+    mHistogram.clear();
+    mSamples.clear();
+    mSeq = 0;
+    mSent = 0;
+    mLost = 0;
+    mUnmatched = 0;
+}
+
+bool GidLatencyProbe::exportCsv(QString path, QString* error) const
+{
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        if (error) { *error = f.errorString(); }
+        return false;
+    }
+
+    QByteArray out = "seq,sent_unix_us,rtt_us\n";
+    foreach (const Sample& s, mSamples) {
+        out += QByteArray::number(s.seq) + ','
+                + QByteArray::number(s.sent.wallClockUs()) + ','
+                + ((s.rttUs < 0) ? QByteArray() : QByteArray::number(s.rttUs))
+                + '\n';
+        if (out.count() > 65536) {
+            f.write(out);
+            out.clear();
+        }
+    }
+    f.write(out);
+    if (f.error() != QFile::NoError) {
+        if (error) { *error = f.errorString(); }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,136 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDLATENCYPROBE_H
+#define GIDLATENCYPROBE_H
+
+#include "gidchunk.h"
+
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+/* GidLatencyHistogram records durations in microseconds in log-linear
+ * buckets, like an HDR histogram: every power of two is divided into 32
+ * buckets, so percentiles are accurate to about 3% over the whole range while
+ * recording is a constant-time index computation. */
+class GidLatencyHistogram
+{
+public:
+    GidLatencyHistogram();
+
+    void record(qint64 us);
+    void clear();
+
+    qint64 count() const { return mCount; }
+    qint64 min() const { return mMin; }
+    qint64 max() const { return mMax; }
+    qint64 mean() const { return mCount ? (mSum / mCount) : 0; }
+    // Value below which the given percentage (0 to 100) of values lie
+    qint64 percentile(double p) const;
+
+    /* Counts per power of two, from 2^bitsFrom up to the highest recorded
+     * value. Index i holds values from 2^(bitsFrom + i) up to
+     * 2^(bitsFrom + i + 1) - 1, index 0 also holds smaller values. */
+    QVector<qint64> octaveCounts(int bitsFrom) const;
+
+private:
+    static const int subBits = 5;
+    static const int subCount = 1 << subBits;
+    static const int maxBits = 40;
+    static int bucketIndex(qint64 us);
+    static qint64 bucketLowest(int index);
+
+    QVector<qint64> mCounts;
+    qint64 mCount = 0;
+    qint64 mSum = 0;
+    qint64 mMin = 0;
+    qint64 mMax = 0;
+};
+
+/* GidLatencyProbe measures round-trip times of request/response exchanges.
+ *
+ * nextRequest() returns the request to send, with {seq} replaced by an
+ * incrementing sequence number, and notes the time it was sent. Received data
+ * is fed to feed() and searched for the response pattern. If the pattern has a
+ * capture group, it is taken as the sequence number of the request the
+ * response belongs to. Otherwise responses are matched to requests in order.
+ * Requests without a response within the timeout are counted as lost. */
+class GidLatencyProbe
+{
+public:
+    struct Sample {
+        quint32 seq;
+        GidTimestamp sent;
+        qint64 rttUs;       // -1 if lost
+    };
+
+    void setRequest(QString request) { mRequest = request; }
+    bool setResponsePattern(QString pattern);
+    QString errorString() const { return mRegex.errorString(); }
+    void setTimeoutMs(int ms) { mTimeoutUs = qint64(ms) * 1000; }
+
+    QByteArray nextRequest(const GidTimestamp& sent);
+    // Returns the number of responses matched
+    int feed(const GidChunk& chunk);
+    // Counts requests older than the timeout as lost
+    void expire(const GidTimestamp& now);
+    int pendingCount() const { return mPending.count(); }
+
+    void clear();
+    const GidLatencyHistogram& histogram() const { return mHistogram; }
+    qint64 sent() const { return mSent; }
+    qint64 lost() const { return mLost; }
+    qint64 unmatched() const { return mUnmatched; }
+
+    // Samples are kept for export up to maxSamples
+    static const int maxSamples = 1000000;
+    const QVector<Sample>& samples() const { return mSamples; }
+    bool exportCsv(QString path, QString* error) const;
+
+private:
+    static const int maxTextLength = 4096;
+
+    struct Pending {
+        quint32 seq;
+        GidTimestamp sent;
+    };
+    QString mRequest;
+    QRegularExpression mRegex;
+    qint64 mTimeoutUs = 1000000;
+    quint32 mSeq = 0;
+    QList<Pending> mPending;
+    // Received text not yet matched, and the time of its last chunk
+    QString mText;
+    GidTimestamp mTextTimestamp;
+
+    GidLatencyHistogram mHistogram;
+    QVector<Sample> mSamples;
+    qint64 mSent = 0;
+    qint64 mLost = 0;
+    qint64 mUnmatched = 0;
+
+    int matchResponses(bool waitForMore);
+    void respond(const QRegularExpressionMatch& m);
+    void addSample(const Pending& p, qint64 rttUs);
+};
+
+#endif // GIDLATENCYPROBE_H
@@ -0,0 +1,158 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidmessagecompiler.h"
+
+#include "gidchecksum.h"
+
+
+namespace {
+
+int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) { return c - '0'; }
+    if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+    if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+    return -1;
+}
+
+} // namespace
+
+/* Literal text between checksum markers is replaced with replaceEscapes(). A
+ * checksum marker is \{...} with a valid spec, where the backslash is not
+ * itself escaped. */
+QByteArray GidMessageCompiler::compile(const QByteArray& text)
+{
+    if (const QByteArray* cached = mCache.object(text)) { return *cached; }
+
+    State state;
+    QByteArray& out = state.out;
+    out.reserve(text.count());
+    int n = text.count();
+    int literalStart = 0;
+
+    for (int i = 1; i < n; i++) {
+        if ((text.at(i) != '{') || (text.at(i - 1) != '\\')) { continue; }
+        int backslashes = 0;
+        for (int k = i - 1; (k >= 0) && (text.at(k) == '\\'); k--) { backslashes++; }
+        if (backslashes % 2 == 0) { continue; }
+        int close = text.indexOf('}', i + 1);
+        if (close < 0) { break; }
+
+        // The checksum covers the text before the marker
+        int size = out.count();
+        out.append(replaceEscapes(text.mid(literalStart, i - 1 - literalStart)));
+        if (appendChecksum(text.mid(i + 1, close - i - 1), state)) {
+            literalStart = close + 1;
+            i = close;
+        } else {
+            // Not a checksum marker, so it is part of the literal text
+            out.truncate(size);
+        }
+    }
+    out.append(replaceEscapes(text.mid(literalStart)));
+
+    mCache.insert(text, new QByteArray(out));
+    return out;
+}
+
+/* Escape sequences are replaced as they were before messages were compiled,
+ * so saved messages keep sending the same bytes: first hex bytes, then \n,
+ * \r, \t, \0 and \\ one after another. E.g. \\n is a backslash and a
+ * newline. A backslash that doesn't start a hex byte is kept with the
+ * character after it, and an unfinished sequence at the end is left out. */
+QByteArray GidMessageCompiler::replaceEscapes(const QByteArray& text)
+{
+    QByteArray out;
+    out.reserve(text.count());
+    int n = text.count();
+    int i = 0;
+    while (i < n) {
+        char c = text.at(i);
+        if (c != '\\') {
+            out.append(c);
+            i++;
+            continue;
+        }
+        if (i + 1 == n) { break; }
+        if (hexValue(text.at(i + 1)) < 0) {
+            out.append(text.constData() + i, 2);
+            i += 2;
+            continue;
+        }
+        if (i + 2 == n) { break; }
+        if (hexValue(text.at(i + 2)) < 0) {
+            out.append(text.constData() + i, 3);
+            i += 3;
+            continue;
+        }
+        out.append(char(hexValue(text.at(i + 1)) * 16 + hexValue(text.at(i + 2))));
+        i += 3;
+    }
+
+    out.replace(QByteArray("\\n"), QByteArray("\n"));
+    out.replace(QByteArray("\\r"), QByteArray("\r"));
+    out.replace(QByteArray("\\t"), QByteArray("\t"));
+    // NB: Do \0 after hex above so it doesn't interfere
+    out.replace(QByteArray("\\0"), QByteArray(1, '\0'));
+    out.replace(QByteArray("\\\\"), QByteArray("\\"));
+    return out;
+}
+
+bool GidMessageCompiler::appendChecksum(const QByteArray& spec, State& state)
+{
+    if (spec.isEmpty()) {
+        state.checksumStart = state.out.count();
+        return true;
+    }
+    if (spec == "/") {
+        state.checksumEnd = state.out.count();
+        return true;
+    }
+
+    QList<QByteArray> parts = spec.split(':');
+    if (parts.count() > 2) { return false; }
+
+    const GidChecksum* checksum = GidChecksum::find(QString::fromLatin1(parts.at(0)));
+    if (!checksum) { return false; }
+
+    GidChecksum::Format format = GidChecksum::FormatDefault;
+    if (parts.count() == 2) {
+        QByteArray f = parts.at(1).trimmed().toLower();
+        if (f == "le") {
+            format = GidChecksum::FormatLittleEndian;
+        } else if (f == "be") {
+            format = GidChecksum::FormatBigEndian;
+        } else if (f == "hex") {
+            format = GidChecksum::FormatHex;
+        } else {
+            return false;
+        }
+    }
+
+    int end = (state.checksumEnd >= state.checksumStart) ? state.checksumEnd
+                                                         : state.out.count();
+    quint32 value = checksum->compute(state.out.constData() + state.checksumStart,
+                                      end - state.checksumStart);
+    state.out.append(checksum->toBytes(value, format));
+    state.checksumStart = state.out.count();
+    state.checksumEnd = -1;
+    return true;
+}
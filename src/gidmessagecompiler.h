@@ -0,0 +1,66 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDMESSAGECOMPILER_H
+#define GIDMESSAGECOMPILER_H
+
+#include <QByteArray>
+#include <QCache>
+
+/* GidMessageCompiler turns message text with escape sequences into the bytes
+ * to be sent:
+ *
+ *   \n \r \t \0 \\      Special characters
+ *   \xx                 Byte from 2 hex digits, e.g. \de\ad
+ *
+ * These are replaced the same way as before messages were compiled, see
+ * replaceEscapes(). Checksums are added with:
+ *
+ *   \{name}             Checksum of the bytes since the start of the message
+ *   \{name:fmt}         or the previous \{...}, e.g. \{crc16-modbus}. fmt is
+ *                       le, be or hex (ASCII hex digits).
+ *   \{}                 Marks the start of the next checksum
+ *   \{/}                Marks the end of the next checksum, if it does not
+ *                       end at the checksum itself
+ *
+ * E.g. an NMEA sentence: $\{}GPGLL,4916.45,N,12311.12,W\{/}*\{xor:hex}\r\n
+ *
+ * See GidChecksum::names() for the checksum names. Unknown sequences are sent
+ * as is.
+ *
+ * The same messages are typically sent over and over (macros, timed messages,
+ * send file), so compiled messages are cached by their text. */
+class GidMessageCompiler
+{
+public:
+    QByteArray compile(const QByteArray& text);
+
+private:
+    QCache<QByteArray, QByteArray> mCache {256};
+    struct State {
+        QByteArray out;
+        int checksumStart = 0;
+        int checksumEnd = -1;
+    };
+    static bool appendChecksum(const QByteArray& spec, State& state);
+    static QByteArray replaceEscapes(const QByteArray& text);
+};
+
+#endif // GIDMESSAGECOMPILER_H
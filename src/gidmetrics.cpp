@@ -0,0 +1,346 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidmetrics.h"
+
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QTimer>
+#include <QTimerEvent>
+#include <QtMath>
+
+
+GidMetrics::Counter* GidMetrics::addCounter(QString name, QString help)
+{
+    Counter* c = new Counter(name, help);
+    mMetrics.append(QSharedPointer<Metric>(c));
+    return c;
+}
+
+GidMetrics::Gauge* GidMetrics::addGauge(QString name, QString help)
+{
+    Gauge* g = new Gauge(name, help);
+    mMetrics.append(QSharedPointer<Metric>(g));
+    return g;
+}
+
+GidMetrics::Rate* GidMetrics::addRate(QString name, QString help,
+                                      Counter* source, double tauSeconds)
+{
+    Rate* r = new Rate(name, help, source, tauSeconds);
+    mMetrics.append(QSharedPointer<Metric>(r));
+    return r;
+}
+
+GidMetrics::Histogram* GidMetrics::addHistogram(QString name, QString help)
+{
+    Histogram* h = new Histogram(name, help);
+    mMetrics.append(QSharedPointer<Metric>(h));
+    return h;
+}
+
+void GidMetrics::tick()
+{
+    if (!mTickTimer.isValid()) {
+        mTickTimer.start();
+        return;
+    }
+    double dt = mTickTimer.nsecsElapsed() / 1e9;
+    mTickTimer.start();
+    if (dt <= 0) { return; }
+
+    foreach (QSharedPointer<Metric> m, mMetrics) {
+        m->tick(dt);
+    }
+}
+
+void GidMetrics::reset()
+{
+    foreach (QSharedPointer<Metric> m, mMetrics) {
+        m->reset();
+    }
+}
+
+QString GidMetrics::toPrometheusText()
+{
+    QString out;
+    foreach (QSharedPointer<Metric> m, mMetrics) {
+        out += QString("# HELP %1 %2\n").arg(m->name).arg(m->help);
+        out += QString("# TYPE %1 %2\n").arg(m->name).arg(m->prometheusType());
+        m->writePrometheus(out);
+    }
+    return out;
+}
+
+QByteArray GidMetrics::toJson()
+{
+    QJsonObject o;
+    foreach (QSharedPointer<Metric> m, mMetrics) {
+        o.insert(m->name, m->toJson());
+    }
+    return QJsonDocument(o).toJson(QJsonDocument::Indented);
+}
+
+void GidMetrics::Counter::writePrometheus(QString& out)
+{
+    out += QString("%1 %2\n").arg(name).arg(value());
+}
+
+QJsonValue GidMetrics::Counter::toJson()
+{
+    // JSON numbers are doubles, exact up to 2^53
+    return QJsonValue(double(value()));
+}
+
+void GidMetrics::Gauge::writePrometheus(QString& out)
+{
+    out += QString("%1 %2\n").arg(name).arg(value());
+}
+
+QJsonValue GidMetrics::Gauge::toJson()
+{
+    return QJsonValue(double(value()));
+}
+
+void GidMetrics::Rate::writePrometheus(QString& out)
+{
+    out += QString("%1 %2\n").arg(name).arg(value(), 0, 'f', 3);
+}
+
+QJsonValue GidMetrics::Rate::toJson()
+{
+    return QJsonValue(value());
+}
+
+void GidMetrics::Rate::tick(double dtSeconds)
+{
+    quint64 count = source->value();
+    if (first || (count < lastCount)) {
+        // First sample or source counter was reset
+        first = false;
+        lastCount = count;
+        return;
+    }
+    double instant = (count - lastCount) / dtSeconds;
+    lastCount = count;
+
+    double alpha = 1.0 - qExp(-dtSeconds / tau);
+    double rate = value();
+    v.store(rate + alpha * (instant - rate), std::memory_order_relaxed);
+}
+
+void GidMetrics::Rate::reset()
+{
+    first = true;
+    v.store(0, std::memory_order_relaxed);
+}
+
+void GidMetrics::Histogram::record(quint64 value)
+{
+    int i = 64 - qCountLeadingZeroBits(value);
+    if (i >= numBuckets) { i = numBuckets - 1; }
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    n.fetch_add(1, std::memory_order_relaxed);
+    s.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 prevMax = m.load(std::memory_order_relaxed);
+    while ((value > prevMax)
+           && !m.compare_exchange_weak(prevMax, value, std::memory_order_relaxed))
+    { }
+}
+
+void GidMetrics::Histogram::writePrometheus(QString& out)
+{
+    // Prometheus buckets are cumulative. The last bucket also holds values
+    // larger than its bound, so it is only reported as +Inf.
+    quint64 cumulative = 0;
+    for (int i = 0; i < numBuckets - 1; i++) {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        quint64 le = (quint64(1) << i) - 1;
+        out += QString("%1_bucket{le=\"%2\"} %3\n").arg(name).arg(le).arg(cumulative);
+    }
+    out += QString("%1_bucket{le=\"+Inf\"} %2\n").arg(name).arg(count());
+    out += QString("%1_sum %2\n").arg(name).arg(sum());
+    out += QString("%1_count %2\n").arg(name).arg(count());
+}
+
+QJsonValue GidMetrics::Histogram::toJson()
+{
+    QJsonObject o;
+    o.insert("count", double(count()));
+    o.insert("sum", double(sum()));
+    o.insert("max", double(max()));
+    // Only non-empty buckets, keyed by upper bound
+    QJsonObject b;
+    for (int i = 0; i < numBuckets; i++) {
+        quint64 c = buckets[i].load(std::memory_order_relaxed);
+        if (c == 0) { continue; }
+        QString le = (i < numBuckets - 1) ? QString::number((quint64(1) << i) - 1)
+                                          : QString("+Inf");
+        b.insert(le, double(c));
+    }
+    o.insert("buckets", b);
+    return o;
+}
+
+void GidMetrics::Histogram::reset()
+{
+    for (int i = 0; i < numBuckets; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    n.store(0, std::memory_order_relaxed);
+    s.store(0, std::memory_order_relaxed);
+    m.store(0, std::memory_order_relaxed);
+}
+
+
+GidMetricsExporter::GidMetricsExporter(GidMetrics* metrics, QObject *parent) :
+    QObject(parent),
+    metrics(metrics)
+{
+    connect(&httpServer, &QTcpServer::newConnection,
+            this, &GidMetricsExporter::onHttpNewConnection);
+}
+
+bool GidMetricsExporter::startHttp(quint16 port)
+{
+    stopHttp();
+    // Only listen on localhost. This is for local dashboards and scrapers.
+    if (httpServer.listen(QHostAddress::LocalHost, port)) {
+        print(QString("Metrics available at http://127.0.0.1:%1/metrics").arg(port));
+        return true;
+    } else {
+        print("ERROR: Metrics HTTP server failed to start: "
+              + httpServer.errorString());
+        return false;
+    }
+}
+
+void GidMetricsExporter::stopHttp()
+{
+    if (httpServer.isListening()) {
+        httpServer.close();
+    }
+}
+
+bool GidMetricsExporter::isHttpRunning()
+{
+    return httpServer.isListening();
+}
+
+void GidMetricsExporter::startJsonFile(QString path, int intervalMs)
+{
+    jsonPath = path;
+    jsonErrorPrinted = false;
+    jsonTimer.start(qMax(100, intervalMs), this);
+    writeJsonFile();
+}
+
+void GidMetricsExporter::stopJsonFile()
+{
+    jsonTimer.stop();
+}
+
+void GidMetricsExporter::onHttpNewConnection()
+{
+    while (httpServer.hasPendingConnections()) {
+        QTcpSocket* socket = httpServer.nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, [=]()
+        {
+            onHttpReadyRead(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected,
+                socket, &QTcpSocket::deleteLater);
+        QTimer::singleShot(httpRequestTimeoutMs, socket, [socket]()
+        {
+            socket->abort();
+            socket->deleteLater();
+        });
+    }
+}
+
+void GidMetricsExporter::onHttpReadyRead(QTcpSocket* socket)
+{
+    // Only the request line is of interest, e.g. "GET /metrics HTTP/1.1".
+    if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > maxHttpRequestLine) {
+            socket->abort();
+            socket->deleteLater();
+        }
+        return;
+    }
+    QList<QByteArray> request = socket->readLine().trimmed().split(' ');
+    socket->readAll();
+
+    QByteArray status = "200 OK";
+    QByteArray contentType;
+    QByteArray body;
+    QByteArray path = request.value(1);
+    if ((request.value(0) != "GET") && (request.value(0) != "HEAD")) {
+        status = "405 Method Not Allowed";
+    } else if ((path == "/metrics") || (path == "/")) {
+        contentType = "text/plain; version=0.0.4";
+        body = metrics->toPrometheusText().toUtf8();
+    } else if (path == "/metrics.json") {
+        contentType = "application/json";
+        body = metrics->toJson();
+    } else {
+        status = "404 Not Found";
+    }
+
+    QByteArray response = "HTTP/1.0 " + status + "\r\n";
+    if (!contentType.isEmpty()) {
+        response += "Content-Type: " + contentType + "\r\n";
+    }
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    if (request.value(0) != "HEAD") {
+        response += body;
+    }
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+void GidMetricsExporter::writeJsonFile()
+{
+    if (jsonPath.isEmpty()) { return; }
+
+    // QSaveFile writes to a temporary file and renames it on commit so readers
+    // never see a partially written file.
+    QSaveFile f(jsonPath);
+    bool ok = f.open(QIODevice::WriteOnly);
+    if (ok) {
+        f.write(metrics->toJson());
+        ok = f.commit();
+    }
+    if (!ok && !jsonErrorPrinted) {
+        print("ERROR: Could not write metrics file: " + f.errorString());
+        jsonErrorPrinted = true;
+    } else if (ok) {
+        jsonErrorPrinted = false;
+    }
+}
+
+void GidMetricsExporter::timerEvent(QTimerEvent* ev)
+{
+    if (ev->timerId() == jsonTimer.timerId()) {
+        writeJsonFile();
+    }
+}
@@ -0,0 +1,194 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDMETRICS_H
+#define GIDMETRICS_H
+
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <atomic>
+
+/* GidMetrics is a registry of counters, gauges, rates and histograms.
+ *
+ * Metrics are registered once (normally at startup) and the returned pointers
+ * stay valid for the lifetime of the registry. Updating a metric only touches
+ * std::atomic values with relaxed ordering so it is cheap and lock-free and may
+ * be done from any thread. Rates are exponentially weighted moving averages of
+ * a counter and are updated by calling tick() periodically.
+ *
+ * The registry can be rendered as Prometheus text exposition format or JSON.
+ * */
+class GidMetrics
+{
+public:
+    class Metric
+    {
+    public:
+        Metric(QString name, QString help) : name(name), help(help) {}
+        virtual ~Metric() {}
+        const QString name;
+        const QString help;
+    protected:
+        friend class GidMetrics;
+        virtual QString prometheusType() = 0;
+        virtual void writePrometheus(QString& out) = 0;
+        virtual QJsonValue toJson() = 0;
+        virtual void tick(double /*dtSeconds*/) {}
+        virtual void reset() {}
+    };
+
+    class Counter : public Metric
+    {
+    public:
+        using Metric::Metric;
+        void add(quint64 n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+        quint64 value() const { return v.load(std::memory_order_relaxed); }
+    protected:
+        QString prometheusType() override { return "counter"; }
+        void writePrometheus(QString& out) override;
+        QJsonValue toJson() override;
+        void reset() override { v.store(0, std::memory_order_relaxed); }
+    private:
+        std::atomic<quint64> v {0};
+    };
+
+    class Gauge : public Metric
+    {
+    public:
+        using Metric::Metric;
+        void set(qint64 value) { v.store(value, std::memory_order_relaxed); }
+        qint64 value() const { return v.load(std::memory_order_relaxed); }
+    protected:
+        QString prometheusType() override { return "gauge"; }
+        void writePrometheus(QString& out) override;
+        QJsonValue toJson() override;
+    private:
+        std::atomic<qint64> v {0};
+    };
+
+    /* Per-second rate of a counter, smoothed with an exponentially weighted
+     * moving average with time constant tauSeconds. */
+    class Rate : public Metric
+    {
+    public:
+        Rate(QString name, QString help, Counter* source, double tauSeconds)
+            : Metric(name, help), source(source), tau(tauSeconds) {}
+        double value() const { return v.load(std::memory_order_relaxed); }
+    protected:
+        QString prometheusType() override { return "gauge"; }
+        void writePrometheus(QString& out) override;
+        QJsonValue toJson() override;
+        void tick(double dtSeconds) override;
+        void reset() override;
+    private:
+        Counter* source = nullptr;
+        double tau = 2.0;
+        quint64 lastCount = 0;
+        bool first = true;
+        std::atomic<double> v {0};
+    };
+
+    /* Histogram with power-of-two buckets. Bucket i holds values with a bit
+     * width of i, i.e. values up to and including 2^i - 1. */
+    class Histogram : public Metric
+    {
+    public:
+        using Metric::Metric;
+        static const int numBuckets = 41;
+        void record(quint64 value);
+        quint64 count() const { return n.load(std::memory_order_relaxed); }
+        quint64 sum() const { return s.load(std::memory_order_relaxed); }
+        quint64 max() const { return m.load(std::memory_order_relaxed); }
+    protected:
+        QString prometheusType() override { return "histogram"; }
+        void writePrometheus(QString& out) override;
+        QJsonValue toJson() override;
+        void reset() override;
+    private:
+        std::atomic<quint64> buckets[numBuckets] {};
+        std::atomic<quint64> n {0};
+        std::atomic<quint64> s {0};
+        std::atomic<quint64> m {0};
+    };
+
+    Counter* addCounter(QString name, QString help);
+    Gauge* addGauge(QString name, QString help);
+    Rate* addRate(QString name, QString help, Counter* source,
+                  double tauSeconds = 2.0);
+    Histogram* addHistogram(QString name, QString help);
+
+    // Update rates. Call periodically from a single thread.
+    void tick();
+    // Reset counters, rates and histograms to zero. Gauges are left as is.
+    void reset();
+
+    QString toPrometheusText();
+    QByteArray toJson();
+
+private:
+    QList<QSharedPointer<Metric>> mMetrics;
+    QElapsedTimer mTickTimer;
+};
+
+/* GidMetricsExporter makes a GidMetrics registry available to external tools,
+ * either via a minimal HTTP endpoint on localhost (Prometheus text at /metrics,
+ * JSON at /metrics.json) or by periodically writing a JSON file. */
+class GidMetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GidMetricsExporter(GidMetrics* metrics, QObject *parent = 0);
+
+    bool startHttp(quint16 port);
+    void stopHttp();
+    bool isHttpRunning();
+
+    void startJsonFile(QString path, int intervalMs);
+    void stopJsonFile();
+
+signals:
+    void print(QString msg);
+
+private:
+    GidMetrics* metrics = nullptr;
+
+    QTcpServer httpServer;
+    // Clients that don't send a request line in time, or send a too long
+    // one, are disconnected
+    static const int httpRequestTimeoutMs = 5000;
+    static const int maxHttpRequestLine = 4096;
+    void onHttpNewConnection();
+    void onHttpReadyRead(QTcpSocket* socket);
+
+    QString jsonPath;
+    QBasicTimer jsonTimer;
+    bool jsonErrorPrinted = false;
+    void writeJsonFile();
+    void timerEvent(QTimerEvent* ev);
+};
+
+#endif // GIDMETRICS_H
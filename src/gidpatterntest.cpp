@@ -0,0 +1,231 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidpatterntest.h"
+
+#include <string.h>
+
+
+GidPatternGenerator::GidPatternGenerator(Pattern pattern, quint32 seed) :
+    mPattern(pattern)
+{
+    // Polynomials as in ITU-T O.150: x^bits + x^tap + 1
+    switch (pattern) {
+    case Prbs7:  mBits = 7;  mTap = 6;  break;
+    case Prbs15: mBits = 15; mTap = 14; break;
+    case Prbs23: mBits = 23; mTap = 18; break;
+    case Prbs31: mBits = 31; mTap = 28; break;
+    default: break;
+    }
+    if (mBits) {
+        mMask = (quint32(1) << mBits) - 1;
+        // The all-zero state would only produce zeros
+        mLfsr = (seed & mMask) ? (seed & mMask) : 1;
+    }
+    mCounter = quint8(seed);
+    mRandom = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+QStringList GidPatternGenerator::names()
+{
+    return {"PRBS-7", "PRBS-15", "PRBS-23", "PRBS-31", "Counter", "Random"};
+}
+
+void GidPatternGenerator::generate(char* out, int n)
+{
+    switch (mPattern) {
+    case Counter:
+        for (int i = 0; i < n; i++) { out[i] = char(mCounter++); }
+        break;
+    case Random:
+        // xorshift64*
+        for (int i = 0; i < n; i++) {
+            mRandom ^= mRandom >> 12;
+            mRandom ^= mRandom << 25;
+            mRandom ^= mRandom >> 27;
+            out[i] = char((mRandom * 0x2545F4914F6CDD1DULL) >> 56);
+        }
+        break;
+    default: {
+        quint32 s = mLfsr;
+        int b1 = mBits - 1;
+        int t1 = mTap - 1;
+        for (int i = 0; i < n; i++) {
+            uint byte = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                quint32 next = ((s >> b1) ^ (s >> t1)) & 1;
+                s = ((s << 1) | next) & mMask;
+                byte = (byte << 1) | next;
+            }
+            out[i] = char(byte);
+        }
+        mLfsr = s;
+    }
+    }
+}
+
+QByteArray GidPatternGenerator::generate(int n)
+{
+    QByteArray ret(n, Qt::Uninitialized);
+    generate(ret.data(), n);
+    return ret;
+}
+
+GidPatternVerifier::GidPatternVerifier(GidPatternGenerator::Pattern pattern,
+                                       quint32 seed) :
+    mGenerator(pattern, seed)
+{
+}
+
+void GidPatternVerifier::ensureExpected(qint64 end)
+{
+    qint64 have = mExpectedBase + mExpected.count();
+    if (end <= have) { return; }
+    int n = int(qMax(end - have, qint64(4096)));
+    int old = mExpected.count();
+    mExpected.resize(old + n);
+    mGenerator.generate(mExpected.data() + old, n);
+}
+
+bool GidPatternVerifier::matchesAt(qint64 pos, const char* rx)
+{
+    if (pos < mExpectedBase) { return false; }
+    ensureExpected(pos + window);
+    return memcmp(mExpected.constData() + (pos - mExpectedBase), rx, window) == 0;
+}
+
+/* A mismatched byte at mPos followed by mostly matching bytes is a bit error,
+ * as lost or duplicated bytes would misalign the bytes that follow. */
+bool GidPatternVerifier::isBitError(const char* rx)
+{
+    ensureExpected(mPos + window);
+    const char* expected = mExpected.constData() + (mPos - mExpectedBase);
+    int matches = 0;
+    for (int k = 1; k < window; k++) {
+        if (rx[k] == expected[k]) { matches++; }
+    }
+    return matches >= errorMatches;
+}
+
+/* Returns the offset from mPos, from minOffset up to (not including)
+ * maxOffset, of the position in the expected stream where the received
+ * window matches, or noOffset. The nearest position is preferred, and after
+ * a position the same distance before it.
+ * Candidates are looked up in an index of the expected stream instead of
+ * comparing every position. The index is rebuilt ahead of mPos when the
+ * search range leaves it. */
+qint64 GidPatternVerifier::findOffset(const char* rx, qint64 minOffset,
+                                      qint64 maxOffset)
+{
+    qint64 from = qMax(mPos + minOffset, mExpectedBase);
+    qint64 to = mPos + maxOffset;
+    if ((from < mIndexFrom) || (to > mIndexTo)) {
+        // Room for duplicated bytes before the position that is searched
+        mIndexFrom = qMax(from - maxDuplicated, mExpectedBase);
+        mIndexTo = mPos + 2 * qint64(maxLost);
+        ensureExpected(mIndexTo + window);
+        mIndex.clear();
+        mIndex.reserve(int(mIndexTo - mIndexFrom));
+        const char* p = mExpected.constData() + (mIndexFrom - mExpectedBase);
+        for (qint64 pos = mIndexFrom; pos < mIndexTo; pos++, p++) {
+            quint32 key;
+            memcpy(&key, p, sizeof(key));
+            mIndex.insert(key, pos);
+        }
+    }
+
+    auto rank = [](qint64 d) { return (d > 0) ? (2 * d - 1) : (-2 * d); };
+    quint32 key;
+    memcpy(&key, rx, sizeof(key));
+    qint64 best = noOffset;
+    auto end = mIndex.constEnd();
+    for (auto it = mIndex.constFind(key); (it != end) && (it.key() == key); ++it) {
+        qint64 d = it.value() - mPos;
+        if ((d < minOffset) || (d >= maxOffset)) { continue; }
+        if ((best != noOffset) && (rank(d) >= rank(best))) { continue; }
+        if (matchesAt(it.value(), rx)) { best = d; }
+    }
+    return best;
+}
+
+void GidPatternVerifier::feed(const QByteArray& data)
+{
+    mRx.append(data);
+    const char* rx = mRx.constData();
+    int n = mRx.count();
+    int i = 0;
+
+    while (i < n) {
+        if (!mSynced) {
+            if (n - i < window) { break; }
+            qint64 d = findOffset(rx + i, 0, maxLost);
+            if (d != noOffset) {
+                mPos += d;
+                mSynced = true;
+            } else {
+                mStats.skippedBytes++;
+                i++;
+                continue;
+            }
+        }
+
+        ensureExpected(mPos + 1);
+        char expected = mExpected.at(int(mPos - mExpectedBase));
+        if (rx[i] == expected) {
+            mStats.bytes++;
+            mPos++;
+            i++;
+            continue;
+        }
+
+        // Mismatch. Wait for enough bytes to tell errors from lost or
+        // duplicated bytes.
+        if (n - i < window) { break; }
+
+        qint64 offset = 0;
+        if (!isBitError(rx + i)) {
+            offset = findOffset(rx + i, -maxDuplicated, maxLost);
+            if (offset == noOffset) { offset = 0; }
+        }
+        if (offset > 0) {
+            mStats.lostBytes += offset;
+            mPos += offset;
+            continue;
+        } else if (offset < 0) {
+            mStats.duplicatedBytes -= offset;
+            mPos += offset;
+            continue;
+        }
+
+        mStats.bitErrors += qPopulationCount(quint8(rx[i] ^ expected));
+        mStats.erroredBytes++;
+        mStats.bytes++;
+        mPos++;
+        i++;
+    }
+    mRx.remove(0, i);
+
+    // Keep enough of the expected stream for duplicates
+    qint64 drop = mPos - mExpectedBase - maxDuplicated;
+    if (drop > maxLost) {
+        mExpected.remove(0, int(drop));
+        mExpectedBase += drop;
+    }
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDPATTERNTEST_H
+#define GIDPATTERNTEST_H
+
+#include <QByteArray>
+#include <QMultiHash>
+#include <QStringList>
+
+/* GidPatternGenerator generates a deterministic test byte stream: a PRBS
+ * (pseudo-random binary sequence from a linear feedback shift register, most
+ * significant bit first), an incrementing 8-bit counter or seeded random
+ * bytes. Two generators with the same pattern and seed produce the same
+ * stream. */
+class GidPatternGenerator
+{
+public:
+    enum Pattern { Prbs7, Prbs15, Prbs23, Prbs31, Counter, Random };
+
+    explicit GidPatternGenerator(Pattern pattern = Prbs15, quint32 seed = 1);
+
+    static QStringList names();
+
+    void generate(char* out, int n);
+    QByteArray generate(int n);
+
+private:
+    Pattern mPattern;
+    int mBits = 0;
+    int mTap = 0;
+    quint32 mMask = 0;
+    quint32 mLfsr = 0;
+    quint8 mCounter = 0;
+    quint64 mRandom = 0;
+};
+
+/* GidPatternVerifier compares received data with the stream of a
+ * GidPatternGenerator, e.g. in a loopback or echo setup.
+ *
+ * The verifier first synchronises to the received data by searching the
+ * expected stream for the first received bytes. When a received byte differs
+ * from the expected byte and most of the following bytes match, the byte is
+ * counted as a bit error. Otherwise the following bytes are searched for in
+ * the expected stream a little before (duplicated bytes) and after (lost
+ * bytes) the current position, and if they are not found, the byte is also
+ * counted as a bit error. Searches look up an index of the expected stream,
+ * so the cost per received byte stays small on a noisy link.
+ *
+ * PRBS-7 repeats every 127 bytes and the counter every 256 bytes, so for
+ * these, lost bytes are only known modulo the period. */
+class GidPatternVerifier
+{
+public:
+    struct Stats {
+        qint64 bytes = 0;           // Bytes compared
+        qint64 bitErrors = 0;
+        qint64 erroredBytes = 0;
+        qint64 lostBytes = 0;
+        qint64 duplicatedBytes = 0;
+        qint64 skippedBytes = 0;    // Received before synchronisation
+    };
+
+    GidPatternVerifier(GidPatternGenerator::Pattern pattern, quint32 seed);
+
+    void feed(const QByteArray& data);
+    bool isSynced() const { return mSynced; }
+    const Stats& stats() const { return mStats; }
+
+private:
+    // Received bytes that must match to (re)synchronise
+    static const int window = 16;
+    static const int maxDuplicated = 256;
+    static const int maxLost = 65536;
+    // Following bytes that must match to take a mismatch as a bit error
+    static const int errorMatches = window * 3 / 4;
+
+    GidPatternGenerator mGenerator;
+    // Expected stream from position mExpectedBase
+    QByteArray mExpected;
+    qint64 mExpectedBase = 0;
+    // Position in the expected stream of the next received byte
+    qint64 mPos = 0;
+    bool mSynced = false;
+    QByteArray mRx;
+    Stats mStats;
+
+    // Positions in the expected stream from mIndexFrom up to mIndexTo, by
+    // their first 4 bytes
+    QMultiHash<quint32, qint64> mIndex;
+    qint64 mIndexFrom = 0;
+    qint64 mIndexTo = 0;
+
+    void ensureExpected(qint64 end);
+    bool matchesAt(qint64 pos, const char* rx);
+    bool isBitError(const char* rx);
+    static const qint64 noOffset = 1LL << 62;
+    qint64 findOffset(const char* rx, qint64 minOffset, qint64 maxOffset);
+};
+
+#endif // GIDPATTERNTEST_H
@@ -0,0 +1,262 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidplotwidget.h"
+
+#include <QPainter>
+#include <QPainterPath>
+
+#include <cmath>
+
+
+GidPlotWidget::GidPlotWidget(QWidget *parent) : QWidget(parent)
+{
+    setMinimumHeight(100);
+}
+
+void GidPlotWidget::Series::append(qint64 t, float v)
+{
+    if (timeUs.count() < samplesPerSeries) {
+        timeUs.append(t);
+        value.append(v);
+    } else {
+        timeUs[start] = t;
+        value[start] = v;
+        start = (start + 1) % samplesPerSeries;
+    }
+}
+
+/* Binary search for the first sample at or after t. Samples are in time order. */
+int GidPlotWidget::Series::firstAtOrAfter(qint64 t) const
+{
+    int lo = 0;
+    int hi = count();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (timeUs.at(index(mid)) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void GidPlotWidget::addSample(const QString& name, const GidTimestamp& timestamp,
+                              double value)
+{
+    static const QList<QColor> colors {
+        QColor(31, 119, 180), QColor(255, 127, 14), QColor(44, 160, 44),
+        QColor(214, 39, 40), QColor(148, 103, 189), QColor(140, 86, 75),
+        QColor(227, 119, 194), QColor(127, 127, 127)
+    };
+
+    Series* s = nullptr;
+    for (int i = 0; i < series.count(); i++) {
+        if (series[i].name == name) { s = &series[i]; break; }
+    }
+    if (!s) {
+        if (series.count() >= maxSeries) { return; }
+        Series n;
+        n.name = name;
+        n.color = colors.at(series.count() % colors.count());
+        series.append(n);
+        s = &series.last();
+    }
+
+    s->append(timestamp.monotonicUs(), float(value));
+    mDirty = true;
+}
+
+void GidPlotWidget::clear()
+{
+    series.clear();
+    update();
+}
+
+void GidPlotWidget::setTimeWindowSeconds(int seconds)
+{
+    mWindowSeconds = qMax(1, seconds);
+    update();
+}
+
+void GidPlotWidget::presentFrame()
+{
+    if (!mDirty) { return; }
+    mDirty = false;
+    update();
+}
+
+void GidPlotWidget::paintEvent(QPaintEvent* /*event*/)
+{
+    QPainter p(this);
+    p.fillRect(rect(), palette().color(QPalette::Base));
+
+    QFontMetrics fm(font());
+    QRect area = rect().adjusted(fm.horizontalAdvance("-0000.00") + 8,
+                                 fm.height() / 2, -8, -fm.height() - 4);
+    if ((area.width() < 10) || (area.height() < 10)) { return; }
+
+    qint64 windowUs = qint64(mWindowSeconds) * 1000000;
+    qint64 t1 = GidTimestamp::now().monotonicUs();
+    qint64 t0 = t1 - windowUs;
+    int nColumns = area.width();
+
+    // Reduce each series to min/max per column. Find the value range on the
+    // way.
+    QVector<QVector<Column>> reduced;
+    float yMin = INFINITY;
+    float yMax = -INFINITY;
+    for (int si = 0; si < series.count(); si++) {
+        const Series& s = series.at(si);
+        columns.fill({0, 0, 0, 0, false}, nColumns);
+        for (int i = s.firstAtOrAfter(t0); i < s.count(); i++) {
+            int k = s.index(i);
+            float v = s.value.at(k);
+            if (!std::isfinite(v)) { continue; }
+            int col = int((s.timeUs.at(k) - t0) * nColumns / windowUs);
+            if (col >= nColumns) { col = nColumns - 1; }
+            Column& c = columns[col];
+            if (!c.valid) {
+                c = {v, v, v, v, true};
+            } else {
+                c.min = qMin(c.min, v);
+                c.max = qMax(c.max, v);
+                c.last = v;
+            }
+            yMin = qMin(yMin, v);
+            yMax = qMax(yMax, v);
+        }
+        reduced.append(columns);
+    }
+
+    if (yMin > yMax) { yMin = 0; yMax = 1; }
+    if (yMin == yMax) { yMin -= 1; yMax += 1; }
+    float margin = (yMax - yMin) * 0.05f;
+    yMin -= margin;
+    yMax += margin;
+    auto yPixel = [&](float v) {
+        return area.bottom() - (v - yMin) / (yMax - yMin) * area.height();
+    };
+
+    // Axes and labels
+    QColor axisColor = palette().color(QPalette::Mid);
+    QColor textColor = palette().color(QPalette::Text);
+    p.setPen(axisColor);
+    p.drawRect(area);
+    for (int i = 0; i <= 4; i++) {
+        float v = yMin + (yMax - yMin) * i / 4;
+        int y = int(yPixel(v));
+        p.setPen(axisColor);
+        p.drawLine(area.left() - 3, y, area.left(), y);
+        p.setPen(textColor);
+        p.drawText(QRect(0, y - fm.height() / 2, area.left() - 5, fm.height()),
+                   Qt::AlignRight | Qt::AlignVCenter, QString::number(v, 'g', 5));
+    }
+    p.drawText(QRect(area.left(), area.bottom() + 2, area.width(), fm.height()),
+               Qt::AlignLeft, QString("-%1 s").arg(mWindowSeconds));
+    p.drawText(QRect(area.left(), area.bottom() + 2, area.width(), fm.height()),
+               Qt::AlignRight, "now");
+
+    // Series
+    p.setClipRect(area);
+    p.setRenderHint(QPainter::Antialiasing, false);
+    for (int si = 0; si < reduced.count(); si++) {
+        const QVector<Column>& cols = reduced.at(si);
+        p.setPen(series.at(si).color);
+        QPainterPath path;
+        bool started = false;
+        for (int col = 0; col < cols.count(); col++) {
+            const Column& c = cols.at(col);
+            if (!c.valid) { continue; }
+            float x = area.left() + col;
+            // Connect from the previous column to the first sample, then
+            // cover the range of the column and end at the last sample.
+            if (!started) {
+                path.moveTo(x, yPixel(c.first));
+                started = true;
+            } else {
+                path.lineTo(x, yPixel(c.first));
+            }
+            if (c.min != c.max) {
+                path.lineTo(x, yPixel(c.min));
+                path.lineTo(x, yPixel(c.max));
+            }
+            path.lineTo(x, yPixel(c.last));
+        }
+        p.drawPath(path);
+    }
+    p.setClipping(false);
+
+    // Legend with the latest values
+    int y = area.top() + fm.ascent() + 2;
+    for (int si = 0; si < series.count(); si++) {
+        const Series& s = series.at(si);
+        if (s.count() == 0) { continue; }
+        p.setPen(s.color);
+        p.drawText(area.left() + 6, y, QString("%1: %2").arg(s.name)
+                   .arg(s.value.at(s.index(s.count() - 1))));
+        y += fm.height();
+    }
+}
+
+GidPlotExtractor::GidPlotExtractor()
+{
+    setPattern("(\\w+)\\s*[=:]\\s*(-?\\d+(?:\\.\\d+)?(?:[eE][-+]?\\d+)?)");
+}
+
+bool GidPlotExtractor::setPattern(QString pattern)
+{
+    mRegex.setPattern(pattern);
+    if (!mRegex.isValid()) { return false; }
+    mRegex.optimize();
+    return true;
+}
+
+void GidPlotExtractor::feed(const GidChunk& chunk, GidPlotWidget* plot)
+{
+    const QByteArray& data = chunk.data;
+    int from = 0;
+    int newline;
+    while ((newline = data.indexOf('\n', from)) >= 0) {
+        mLine.append(data.constData() + from, newline - from);
+        extract(mLine, chunk.timestamp, plot);
+        mLine.clear();
+        from = newline + 1;
+    }
+    mLine.append(data.constData() + from, data.count() - from);
+    if (mLine.count() > maxLineLength) { mLine.clear(); }
+}
+
+void GidPlotExtractor::extract(const QByteArray& line, const GidTimestamp& timestamp,
+                               GidPlotWidget* plot)
+{
+    if (!mRegex.isValid()) { return; }
+
+    bool named = (mRegex.captureCount() >= 2);
+    QRegularExpressionMatchIterator it = mRegex.globalMatch(QString::fromLatin1(line));
+    while (it.hasNext()) {
+        QRegularExpressionMatch m = it.next();
+        bool ok = false;
+        double value = m.capturedRef(named ? 2 : 1).toDouble(&ok);
+        if (!ok) { continue; }
+        plot->addSample(named ? m.captured(1) : QString("value"), timestamp, value);
+    }
+}
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDPLOTWIDGET_H
+#define GIDPLOTWIDGET_H
+
+#include "gidchunk.h"
+
+#include <QColor>
+#include <QList>
+#include <QRegularExpression>
+#include <QVector>
+#include <QWidget>
+
+/* GidPlotWidget plots series of numeric samples against time.
+ *
+ * Each series keeps its samples in a ring buffer. When drawn, the samples in
+ * the time window are reduced to the minimum, maximum, first and last value
+ * per pixel column, so the cost of drawing depends on the width of the widget
+ * rather than the number of samples.
+ *
+ * Like the console, added samples are only drawn when presentFrame() is
+ * called. */
+class GidPlotWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit GidPlotWidget(QWidget *parent = 0);
+
+    void addSample(const QString& series, const GidTimestamp& timestamp, double value);
+    void clear();
+    void setTimeWindowSeconds(int seconds);
+    void presentFrame();
+
+    static const int maxSeries = 16;
+    static const int samplesPerSeries = 1 << 20;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    struct Series {
+        QString name;
+        QColor color;
+        // Ring buffer. Once full, start is the index of the oldest sample.
+        QVector<qint64> timeUs;
+        QVector<float> value;
+        int start = 0;
+        int count() const { return timeUs.count(); }
+        int index(int i) const { return (start + i) % timeUs.count(); }
+        void append(qint64 t, float v);
+        int firstAtOrAfter(qint64 t) const;
+    };
+    QList<Series> series;
+    int mWindowSeconds = 10;
+    bool mDirty = false;
+
+    // Per pixel column, reused between paints
+    struct Column {
+        float min, max, first, last;
+        bool valid;
+    };
+    QVector<Column> columns;
+};
+
+/* GidPlotExtractor splits received data into lines and extracts samples with
+ * a regular expression, compiled once when set. With two capture groups, the
+ * first is the series name and the second the value, e.g. temp=23.4. With one
+ * capture group, it is the value of a series named "value". */
+class GidPlotExtractor
+{
+public:
+    GidPlotExtractor();
+
+    bool setPattern(QString pattern);
+    QString errorString() const { return mRegex.errorString(); }
+    void feed(const GidChunk& chunk, GidPlotWidget* plot);
+    void reset() { mLine.clear(); }
+
+private:
+    static const int maxLineLength = 4096;
+    QRegularExpression mRegex;
+    QByteArray mLine;
+    void extract(const QByteArray& line, const GidTimestamp& timestamp,
+                 GidPlotWidget* plot);
+};
+
+#endif // GIDPLOTWIDGET_H
@@ -0,0 +1,330 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidprotocoldecoder.h"
+
+#include "gidchecksum.h"
+
+#include <QStringList>
+
+
+// ----------------------------------------------------------------------------
+// Modbus RTU
+
+namespace {
+
+const int modbusMinFrame = 4;   // Address, function code, CRC
+const int modbusMaxFrame = 256;
+
+quint16 u16(const QByteArray& data, int i)
+{
+    return (quint16(uchar(data.at(i))) << 8) | uchar(data.at(i + 1));
+}
+
+QString modbusFunctionName(int fc)
+{
+    switch (fc) {
+    case 1: return "read coils";
+    case 2: return "read discrete inputs";
+    case 3: return "read holding registers";
+    case 4: return "read input registers";
+    case 5: return "write single coil";
+    case 6: return "write single register";
+    case 15: return "write multiple coils";
+    case 16: return "write multiple registers";
+    default: return "";
+    }
+}
+
+QString modbusExceptionName(int code)
+{
+    switch (code) {
+    case 1: return "illegal function";
+    case 2: return "illegal data address";
+    case 3: return "illegal data value";
+    case 4: return "server device failure";
+    case 5: return "acknowledge";
+    case 6: return "server device busy";
+    default: return "";
+    }
+}
+
+} // namespace
+
+GidModbusRtuDecoder::GidModbusRtuDecoder(int baud, int bitsPerChar)
+{
+    mCharUs = qMax(qint64(1), qint64(bitsPerChar) * 1000000 / qMax(1, baud));
+    // The spec fixes the gap at 1.75 ms above 19200 baud
+    mGapUs = (baud > 19200) ? 1750 : (mCharUs * 7) / 2;
+}
+
+void GidModbusRtuDecoder::feed(const GidChunk& chunk, QList<Message>& messages)
+{
+    if (!mBuffer.isEmpty() && mLastTimestamp.isValid() && chunk.timestamp.isValid()) {
+        // Silence before the first byte of this chunk
+        qint64 gap = mLastTimestamp.usecsTo(chunk.timestamp)
+                     - chunk.data.count() * mCharUs;
+        if (gap >= mGapUs) { finishFrame(messages); }
+    }
+
+    if (mBuffer.isEmpty()) { mFrameTimestamp = chunk.timestamp; }
+    mBuffer.append(chunk.data);
+    mLastTimestamp = chunk.timestamp;
+
+    // No gap in a long time. Don't let the buffer grow without bound.
+    if (mBuffer.count() > modbusMaxFrame * 4) { finishFrame(messages); }
+}
+
+void GidModbusRtuDecoder::idle(const GidTimestamp& now, QList<Message>& messages)
+{
+    if (mBuffer.isEmpty()) { return; }
+    if (mLastTimestamp.usecsTo(now) >= mGapUs) { finishFrame(messages); }
+}
+
+void GidModbusRtuDecoder::reset()
+{
+    mBuffer.clear();
+    mLastTimestamp = GidTimestamp();
+}
+
+void GidModbusRtuDecoder::finishFrame(QList<Message>& messages)
+{
+    const char* data = mBuffer.constData();
+    int n = mBuffer.count();
+    const GidChecksum& crc16 = GidChecksum::get(GidChecksum::Crc16Modbus);
+
+    // The CRC over a frame including its CRC is 0.
+    int start = 0;
+    if ((n >= modbusMinFrame) && (crc16.compute(data, n) == 0)) {
+        Message m;
+        m.timestamp = mFrameTimestamp;
+        m.raw = mBuffer;
+        m.checksumOk = true;
+        m.text = describe(mBuffer);
+        messages.append(m);
+        start = n;
+    }
+
+    // Otherwise the bytes may be more than one frame without a detectable gap
+    // in between. Split where the CRC of the bytes so far is valid.
+    while (start < n) {
+        quint32 crc = crc16.initial();
+        int end = -1;
+        for (int i = start; i < n; i++) {
+            crc = crc16.update(crc, data + i, 1);
+            if ((crc == 0) && (i + 1 - start >= modbusMinFrame)) {
+                end = i + 1;
+                break;
+            }
+        }
+        Message m;
+        m.timestamp = mFrameTimestamp;
+        if (end < 0) {
+            m.raw = mBuffer.mid(start);
+            m.checksumOk = false;
+            m.text = (m.raw.count() < modbusMinFrame) ? "incomplete frame"
+                                                     : describe(m.raw);
+            end = n;
+        } else {
+            m.raw = mBuffer.mid(start, end - start);
+            m.checksumOk = true;
+            m.text = describe(m.raw);
+        }
+        messages.append(m);
+        start = end;
+    }
+
+    mBuffer.clear();
+}
+
+QString GidModbusRtuDecoder::describe(const QByteArray& frame)
+{
+    int address = uchar(frame.at(0));
+    int fc = uchar(frame.at(1));
+    QByteArray p = frame.mid(2, frame.count() - 4);
+
+    QString s = QString("slave %1 fc %2").arg(address).arg(fc);
+
+    if (fc & 0x80) {
+        s += QString(" (%1) exception").arg(modbusFunctionName(fc & 0x7F));
+        if (p.count() >= 1) {
+            int code = uchar(p.at(0));
+            s += QString(" %1 %2").arg(code).arg(modbusExceptionName(code));
+        }
+        return s;
+    }
+
+    QString name = modbusFunctionName(fc);
+    if (!name.isEmpty()) { s += QString(" (%1)").arg(name); }
+
+    bool response = (p.count() >= 1) && (uchar(p.at(0)) == p.count() - 1);
+
+    switch (fc) {
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+        // Register responses always have an even byte count, so a request
+        // with a length that looks like a byte count is still recognised.
+        if (response && !(((fc == 3) || (fc == 4)) && (p.count() % 2 == 0))) {
+            s += QString(": %1 bytes:").arg(uchar(p.at(0)));
+            if ((fc == 3) || (fc == 4)) {
+                for (int i = 1; i + 1 < p.count(); i += 2) {
+                    s += QString(" %1").arg(u16(p, i));
+                }
+            } else {
+                s += " " + p.mid(1).toHex(' ').toUpper();
+            }
+            return s;
+        } else if (p.count() == 4) {
+            return s + QString(": start %1 count %2").arg(u16(p, 0)).arg(u16(p, 2));
+        }
+        break;
+    case 5:
+    case 6:
+        if (p.count() == 4) {
+            return s + QString(": address %1 value %2").arg(u16(p, 0)).arg(u16(p, 2));
+        }
+        break;
+    case 15:
+    case 16:
+        if (p.count() == 4) {
+            return s + QString(": start %1 count %2").arg(u16(p, 0)).arg(u16(p, 2));
+        } else if ((p.count() >= 5) && (uchar(p.at(4)) == p.count() - 5)) {
+            s += QString(": start %1 count %2:").arg(u16(p, 0)).arg(u16(p, 2));
+            if (fc == 16) {
+                for (int i = 5; i + 1 < p.count(); i += 2) {
+                    s += QString(" %1").arg(u16(p, i));
+                }
+            } else {
+                s += " " + p.mid(5).toHex(' ').toUpper();
+            }
+            return s;
+        }
+        break;
+    }
+
+    if (!p.isEmpty()) { s += ": " + p.toHex(' ').toUpper(); }
+    return s;
+}
+
+
+// ----------------------------------------------------------------------------
+// NMEA 0183
+
+namespace {
+
+QStringList nmeaFieldNames(const QByteArray& type)
+{
+    if (type == "GGA") {
+        return {"time", "lat", "ns", "lon", "ew", "quality", "sats", "hdop",
+                "alt", "altUnit", "geoid", "geoidUnit", "age", "station"};
+    } else if (type == "RMC") {
+        return {"time", "status", "lat", "ns", "lon", "ew", "knots", "course",
+                "date", "magVar", "magEw", "mode"};
+    } else if (type == "GLL") {
+        return {"lat", "ns", "lon", "ew", "time", "status", "mode"};
+    } else if (type == "VTG") {
+        return {"courseTrue", "t", "courseMag", "m", "knots", "n", "kmh", "k",
+                "mode"};
+    } else if (type == "GSA") {
+        return {"selection", "fix", "sv1", "sv2", "sv3", "sv4", "sv5", "sv6",
+                "sv7", "sv8", "sv9", "sv10", "sv11", "sv12", "pdop", "hdop",
+                "vdop"};
+    } else if (type == "ZDA") {
+        return {"time", "day", "month", "year", "zoneHours", "zoneMinutes"};
+    }
+    return {};
+}
+
+int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) { return c - '0'; }
+    if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+    if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+    return -1;
+}
+
+} // namespace
+
+void GidNmeaDecoder::feed(const GidChunk& chunk, QList<Message>& messages)
+{
+    mBuffer.append(chunk.data);
+
+    int from = 0;
+    int newline;
+    while ((newline = mBuffer.indexOf('\n', from)) >= 0) {
+        // Ignore anything before the start of the sentence
+        int start = from;
+        while ((start < newline) && (mBuffer.at(start) != '$')
+               && (mBuffer.at(start) != '!')) {
+            start++;
+        }
+        int end = newline;
+        if ((end > start) && (mBuffer.at(end - 1) == '\r')) { end--; }
+        if (start < end) {
+            messages.append(decodeSentence(mBuffer.mid(start, end - start),
+                                           chunk.timestamp));
+        }
+        from = newline + 1;
+    }
+    mBuffer.remove(0, from);
+
+    // No newline in a long time. Not NMEA, or a newline was lost.
+    if (mBuffer.count() > maxSentenceLength) { mBuffer.clear(); }
+}
+
+GidProtocolDecoder::Message GidNmeaDecoder::decodeSentence(
+        const QByteArray& line, const GidTimestamp& timestamp)
+{
+    Message m;
+    m.timestamp = timestamp;
+    m.raw = line;
+
+    int star = line.lastIndexOf('*');
+    QByteArray body = line.mid(1, (star < 0) ? -1 : star - 1);
+
+    quint32 sum = GidChecksum::get(GidChecksum::Xor).compute(body);
+
+    QString status;
+    if ((star >= 0) && (star + 2 < line.count())
+            && (hexValue(line.at(star + 1)) >= 0) && (hexValue(line.at(star + 2)) >= 0)) {
+        int expected = hexValue(line.at(star + 1)) * 16 + hexValue(line.at(star + 2));
+        m.checksumOk = (quint32(expected) == sum);
+    } else {
+        m.checksumOk = true;
+        status = " (no checksum)";
+    }
+
+    QList<QByteArray> fields = body.split(',');
+    QByteArray address = fields.takeFirst();
+    // Proprietary sentences start with P. Others have a 2 character talker.
+    QByteArray type = address.startsWith('P') ? address : address.mid(2);
+    QStringList names = nmeaFieldNames(type);
+
+    m.text = QString::fromLatin1(address);
+    for (int i = 0; i < fields.count(); i++) {
+        if (fields.at(i).isEmpty()) { continue; }
+        QString name = (i < names.count()) ? names.at(i) : QString::number(i + 1);
+        m.text += QString(" %1=%2").arg(name).arg(QString::fromLatin1(fields.at(i)));
+    }
+    m.text += status;
+    return m;
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDPROTOCOLDECODER_H
+#define GIDPROTOCOLDECODER_H
+
+#include "gidchunk.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/* GidProtocolDecoder decodes messages of a protocol from the received byte
+ * stream. Chunks are fed as they are received and decoded messages are
+ * returned with their checksum status and a readable description of their
+ * fields. */
+class GidProtocolDecoder
+{
+public:
+    struct Message {
+        GidTimestamp timestamp;
+        QByteArray raw;
+        bool checksumOk = false;
+        QString text;
+    };
+
+    virtual ~GidProtocolDecoder() {}
+
+    virtual QString name() const = 0;
+    virtual void feed(const GidChunk& chunk, QList<Message>& messages) = 0;
+    /* If usesIdle(), idle() is called periodically while pendingBytes() > 0
+     * so the decoder can finish a message that is ended by silence on the
+     * line. */
+    virtual bool usesIdle() const { return false; }
+    virtual void idle(const GidTimestamp& /*now*/, QList<Message>& /*messages*/) {}
+    virtual int pendingBytes() const = 0;
+    virtual void reset() = 0;
+};
+
+/* Modbus RTU. Frames are separated by at least 3.5 character times of
+ * silence. Gaps are measured between the timestamps of received chunks, less
+ * the time it took to transmit the bytes of the later chunk. If chunks contain
+ * more than one frame (e.g. due to USB latency), a frame is split where the
+ * CRC of the bytes so far is valid. The CRC is computed with GidChecksum. */
+class GidModbusRtuDecoder : public GidProtocolDecoder
+{
+public:
+    /* bitsPerChar includes start, parity and stop bits, e.g. 10 for 8N1 */
+    GidModbusRtuDecoder(int baud, int bitsPerChar);
+
+    QString name() const override { return "modbus"; }
+    void feed(const GidChunk& chunk, QList<Message>& messages) override;
+    bool usesIdle() const override { return true; }
+    void idle(const GidTimestamp& now, QList<Message>& messages) override;
+    int pendingBytes() const override { return mBuffer.count(); }
+    void reset() override;
+
+private:
+    qint64 mCharUs;
+    qint64 mGapUs;
+    QByteArray mBuffer;
+    GidTimestamp mFrameTimestamp;
+    GidTimestamp mLastTimestamp;
+
+    void finishFrame(QList<Message>& messages);
+    static QString describe(const QByteArray& frame);
+};
+
+/* NMEA 0183. Sentences start with '$' or '!' and end with a newline. The
+ * checksum is the XOR of the characters between the start character and '*'.
+ * Sentences without a checksum are reported as such. */
+class GidNmeaDecoder : public GidProtocolDecoder
+{
+public:
+    QString name() const override { return "nmea"; }
+    void feed(const GidChunk& chunk, QList<Message>& messages) override;
+    int pendingBytes() const override { return mBuffer.count(); }
+    void reset() override { mBuffer.clear(); }
+
+private:
+    static const int maxSentenceLength = 256;
+    QByteArray mBuffer;
+
+    Message decodeSentence(const QByteArray& line, const GidTimestamp& timestamp);
+};
+
+#endif // GIDPROTOCOLDECODER_H
@@ -21,6 +21,17 @@
 #include "gidqt5serial.h"
 #include "ui_gidqt5serial.h"
 
+#include <QFile>
+#include <QIntValidator>
+
+#ifdef Q_OS_LINUX
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
 
 GidQt5Serial::GidQt5Serial(QWidget *parent) :
     QMainWindow(parent),
@@ -30,7 +41,11 @@ GidQt5Serial::GidQt5Serial(QWidget *parent) :
 
     ui->label_PortStatus->clear();
 
-    refreshSerialPortList();
+    connect(&mPortWatcher, &GidSerialPortWatcher::portsChanged,
+            this, &GidQt5Serial::updateSerialPortList);
+    connect(&mPortWatcher, &GidSerialPortWatcher::busyChecked,
+            this, &GidQt5Serial::onPortBusyChecked);
+    // Ports are listed when the dialog is shown
 
     // Set up Baud rate combo box
     ui->comboBox_BaudRate->addItem(QString::number(QSerialPort::Baud1200));
@@ -41,7 +56,17 @@ GidQt5Serial::GidQt5Serial(QWidget *parent) :
     ui->comboBox_BaudRate->addItem(QString::number(QSerialPort::Baud38400));
     ui->comboBox_BaudRate->addItem(QString::number(QSerialPort::Baud57600));
     ui->comboBox_BaudRate->addItem(QString::number(QSerialPort::Baud115200));
-    ui->comboBox_BaudRate->setCurrentIndex(ui->comboBox_BaudRate->count()-1);
+    int defaultBaudIndex = ui->comboBox_BaudRate->count()-1;
+    // Rates above 115200 are not in QSerialPort::BaudRate but are supported
+    // by most USB-serial adapters
+    const QList<int> highBaudRates {230400, 460800, 500000, 576000, 921600,
+                                    1000000, 1152000, 1500000, 2000000,
+                                    2500000, 3000000, 3500000, 4000000};
+    foreach (int baud, highBaudRates) {
+        ui->comboBox_BaudRate->addItem(QString::number(baud));
+    }
+    ui->comboBox_BaudRate->setCurrentIndex(defaultBaudIndex);
+    ui->comboBox_BaudRate->setValidator(new QIntValidator(minBaudRate, maxBaudRate, this));
 
     // Set up parity combo box
     parityComboBoxList.append(QSerialPort::NoParity);
@@ -64,6 +89,20 @@ GidQt5Serial::GidQt5Serial(QWidget *parent) :
     stopBitsComboBoxList.append(QSerialPort::TwoStop);
     ui->comboBox_StopBits->addItem(QVariant::fromValue(QSerialPort::TwoStop).toString());
     ui->comboBox_StopBits->setCurrentIndex(0); // Default one stop bit
+
+    // Set up flow control combo box
+    flowControlComboBoxList.append(QSerialPort::NoFlowControl);
+    ui->comboBox_FlowControl->addItem(QVariant::fromValue(QSerialPort::NoFlowControl).toString());
+    flowControlComboBoxList.append(QSerialPort::HardwareControl);
+    ui->comboBox_FlowControl->addItem(QVariant::fromValue(QSerialPort::HardwareControl).toString());
+    flowControlComboBoxList.append(QSerialPort::SoftwareControl);
+    ui->comboBox_FlowControl->addItem(QVariant::fromValue(QSerialPort::SoftwareControl).toString());
+    ui->comboBox_FlowControl->setCurrentIndex(0); // Default no flow control
+
+    connect(&s, &QSerialPort::bytesWritten, this, [=](qint64 bytes)
+    {
+        mFlowWrittenSincePoll += bytes;
+    });
 }
 
 GidQt5Serial::~GidQt5Serial()
@@ -80,9 +119,16 @@ void GidQt5Serial::closeEvent(QCloseEvent *event)
 void GidQt5Serial::showEvent(QShowEvent* /*event*/)
 {
     ui->lineEdit_PortName->setFocus();
+    refreshSerialPortList();
+    mPortWatcher.setAutoRefresh(true);
+}
+
+void GidQt5Serial::hideEvent(QHideEvent* /*event*/)
+{
+    mPortWatcher.setAutoRefresh(false);
 }
 
-void GidQt5Serial::openSerialPort()
+bool GidQt5Serial::openSerialPort()
 {
     if (s.open(QIODevice::ReadWrite)) {
         // Port Opened!
@@ -108,10 +154,21 @@ void GidQt5Serial::openSerialPort()
             print("Failed to set stop bits: " + s.errorString());
         }
 
-        if ( !s.setFlowControl(s.NoFlowControl) ) {
+        QSerialPort::FlowControl flowControl = flowControlComboBoxList.value(ui->comboBox_FlowControl->currentIndex());
+        if ( !s.setFlowControl(flowControl) ) {
             print("Error setting flow control: " + s.errorString());
         }
 
+        s.setReadBufferSize(ui->spinBox_ReadBufferSize->value());
+        if (ui->checkBox_LowLatency->isChecked()) { enableLowLatency(); }
+        mCoalesceMs = ui->spinBox_CoalesceMs->value();
+        savePortProfile(s.portName());
+        startFlowControlMonitor();
+
+        // After the last setter, as each one rewrites the line settings and
+        // would undo a custom rate.
+        verifyBaudRate(baudrate);
+
         print(QString("Port opened: %1 @ %2 %3 %4 %5 %6")
               .arg(s.portName())
               .arg(QString::number(s.baudRate()))
@@ -122,38 +179,254 @@ void GidQt5Serial::openSerialPort()
 
         emit portOpened();
         this->hide();
+        return true;
 
     } else {
         // Error opening port.
         ui->label_PortStatus->setText("Error opening port: " + s.errorString());
+        return false;
+    }
+}
+
+/* On Linux, the rate the driver actually uses is read back. If it differs,
+ * the rate is set with termios2 and BOTHER, which allows any rate the driver
+ * supports rather than only the standard Bxxx rates. */
+void GidQt5Serial::verifyBaudRate(int baud)
+{
+#ifdef Q_OS_LINUX
+    int fd = int(s.handle());
+    struct termios2 t;
+    if (ioctl(fd, TCGETS2, &t) != 0) { return; }
+    if ((int(t.c_ospeed) == baud) && (int(t.c_ispeed) == baud)) { return; }
+
+    t.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    t.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    t.c_ospeed = baud;
+    t.c_ispeed = baud;
+    if ((ioctl(fd, TCSETS2, &t) != 0) || (ioctl(fd, TCGETS2, &t) != 0)) {
+        print(QString("Failed to set baud rate %1: %2").arg(baud).arg(strerror(errno)));
+    } else if (int(t.c_ospeed) != baud) {
+        print(QString("Baud rate %1 is not supported by the driver, it uses %2.")
+              .arg(baud).arg(t.c_ospeed));
+    }
+#else
+    if (s.baudRate() != baud) {
+        print(QString("Baud rate %1 is not supported by the driver.").arg(baud));
+    }
+#endif
+}
+
+double GidQt5Serial::bitsPerCharacter()
+{
+    double stop = 1;
+    if (s.stopBits() == QSerialPort::OneAndHalfStop) { stop = 1.5; }
+    else if (s.stopBits() == QSerialPort::TwoStop) { stop = 2; }
+    int parity = (s.parity() == QSerialPort::NoParity) ? 0 : 1;
+    return 1 + s.dataBits() + parity + stop;
+}
+
+double GidQt5Serial::lineCapacity()
+{
+    return s.baudRate() / bitsPerCharacter();
+}
+
+/* On Linux, ASYNC_LOW_LATENCY makes the tty layer pass received data on
+ * immediately. FTDI adapters additionally hold received data in the adapter
+ * for their latency timer (16 ms by default), which is lowered to 1 ms.
+ * With the option off, the driver is left as configured by the system (e.g.
+ * udev rules or setserial). */
+void GidQt5Serial::enableLowLatency()
+{
+#ifdef Q_OS_LINUX
+    int fd = int(s.handle());
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+        if (!(ss.flags & ASYNC_LOW_LATENCY)) {
+            ss.flags |= ASYNC_LOW_LATENCY;
+            if (ioctl(fd, TIOCSSERIAL, &ss) != 0) {
+                print(QString("Failed to set low latency mode: %1")
+                      .arg(strerror(errno)));
+            }
+        }
+    } else {
+        print("Low latency mode is not supported by the driver of this port.");
     }
+
+    QFile timer(QString("/sys/bus/usb-serial/devices/%1/latency_timer")
+                .arg(s.portName()));
+    if (!timer.exists()) { return; }
+    if (timer.open(QIODevice::ReadOnly)) {
+        int ms = timer.readAll().trimmed().toInt();
+        timer.close();
+        if (ms <= 1) { return; }
+    }
+    if (!timer.open(QIODevice::WriteOnly) || (timer.write("1") != 1)) {
+        print(QString("Failed to set FTDI latency timer, no write access to %1")
+              .arg(timer.fileName()));
+    }
+#else
+    print("Low latency mode is only supported on Linux.");
+#endif
+}
+
+void GidQt5Serial::startFlowControlMonitor()
+{
+    mFlowStats = FlowControlStats();
+    mFlowClock.start();
+    mFlowLastPollUs = 0;
+    mFlowLastDrainUs = 0;
+    mFlowLastOutQueue = 0;
+    mFlowWrittenSincePoll = 0;
+    if (s.flowControl() != QSerialPort::NoFlowControl) {
+        mFlowTimer.start(5, Qt::PreciseTimer, this);
+    } else {
+        mFlowTimer.stop();
+    }
+}
+
+void GidQt5Serial::pollFlowControl()
+{
+    if (!s.isOpen() || (s.flowControl() == QSerialPort::NoFlowControl)) {
+        mFlowTimer.stop();
+        mFlowStats.blocked = false;
+        return;
+    }
+
+    qint64 now = mFlowClock.nsecsElapsed() / 1000;
+    bool blocked = false;
+    if (s.flowControl() == QSerialPort::HardwareControl) {
+        blocked = !(s.pinoutSignals() & QSerialPort::ClearToSendSignal);
+    }
+
+#ifdef Q_OS_LINUX
+    // The output queue is stalled if it did not drain for longer than it
+    // takes to send a few characters. Bytes written since the last poll are
+    // taken into account, as the queue grows by those.
+    int queued = 0;
+    if (ioctl(int(s.handle()), TIOCOUTQ, &queued) == 0) {
+        bool drained = (queued == 0)
+                || (queued < mFlowLastOutQueue + mFlowWrittenSincePoll);
+        if (drained) { mFlowLastDrainUs = now; }
+        qint64 charUs = 11 * 1000000LL / qMax(s.baudRate(), 1);
+        if (!drained && (now - mFlowLastDrainUs > 4 * charUs + 10000)) {
+            blocked = true;
+        }
+        mFlowLastOutQueue = queued;
+    }
+#endif
+    mFlowWrittenSincePoll = 0;
+
+    if (blocked) {
+        if (!mFlowStats.blocked) { mFlowStats.stalls++; }
+        mFlowStats.blockedUs += now - mFlowLastPollUs;
+    }
+    mFlowStats.blocked = blocked;
+    mFlowLastPollUs = now;
+}
+
+void GidQt5Serial::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == mFlowTimer.timerId()) {
+        pollFlowControl();
+    } else {
+        QMainWindow::timerEvent(event);
+    }
+}
+
+QString GidQt5Serial::portProfileKey(QString port, QString option)
+{
+    if (port.startsWith("/dev/")) { port.remove(0, 5); }
+    port.replace('/', '_');
+    port.replace('\\', '_');
+    return QString("ports/%1/%2").arg(port).arg(option);
 }
 
+void GidQt5Serial::loadPortProfile(QString port)
+{
+    QString key = portProfileKey(port, "lowLatency");
+    if (!mPortProfiles.contains(key)) { return; }
+
+    ui->checkBox_LowLatency->setChecked(mPortProfiles.value(key).toInt());
+    ui->spinBox_ReadBufferSize->setValue(
+                mPortProfiles.value(portProfileKey(port, "readBufferSize")).toInt());
+    ui->spinBox_CoalesceMs->setValue(
+                mPortProfiles.value(portProfileKey(port, "coalesceMs")).toInt());
+}
+
+void GidQt5Serial::savePortProfile(QString port)
+{
+    mPortProfiles.insert(portProfileKey(port, "lowLatency"),
+                         QString::number(ui->checkBox_LowLatency->isChecked()));
+    mPortProfiles.insert(portProfileKey(port, "readBufferSize"),
+                         QString::number(ui->spinBox_ReadBufferSize->value()));
+    mPortProfiles.insert(portProfileKey(port, "coalesceMs"),
+                         QString::number(ui->spinBox_CoalesceMs->value()));
+}
+
+/* Ports are enumerated in the background. The list is updated when done. */
 void GidQt5Serial::refreshSerialPortList()
 {
-    ui->listWidget_Ports->clear();
+    mPortWatcher.refresh();
+}
+
+void GidQt5Serial::updateSerialPortList()
+{
+    QString selected;
+    if (ui->listWidget_Ports->currentRow() >= 0) {
+        selected = serialPortList.value(ui->listWidget_Ports->currentRow()).portName();
+    }
 
-    serialPortList = QSerialPortInfo::availablePorts();
+    ui->listWidget_Ports->clear();
+    serialPortList = mPortWatcher.ports();
     for (int i=0; i<serialPortList.count(); i++) {
         QString name = serialPortList[i].portName();
-        if (serialPortList[i].isBusy()) {
-            name.append(" (busy)");
-        }
         ui->listWidget_Ports->addItem(name);
+        if (name == selected) {
+            ui->listWidget_Ports->setCurrentRow(i);
+        }
     }
 }
 
-void GidQt5Serial::open()
+void GidQt5Serial::onPortBusyChecked(QString portName, bool busy)
 {
-    on_pushButton_OpenPort_clicked();
+    for (int i=0; i<serialPortList.count(); i++) {
+        if (serialPortList[i].portName() != portName) { continue; }
+        QListWidgetItem* item = ui->listWidget_Ports->item(i);
+        if (item) {
+            item->setText(busy ? portName + " (busy)" : portName);
+        }
+    }
+}
+
+bool GidQt5Serial::open()
+{
+    if (ui->lineEdit_PortName->text().isEmpty()) {
+        ui->label_PortStatus->setText("Specify a serial port.");
+        return false;
+    }
+    int baud = ui->comboBox_BaudRate->currentText().toInt();
+    if ((baud < minBaudRate) || (baud > maxBaudRate)) {
+        ui->label_PortStatus->setText(QString("Baud rate must be from %1 to %2.")
+                                      .arg(minBaudRate).arg(maxBaudRate));
+        return false;
+    }
+    ui->label_PortStatus->clear();
+
+    if (s.isOpen()) {
+        s.close();
+    }
+
+    s.setPortName(ui->lineEdit_PortName->text());
+
+    return openSerialPort();
 }
 
-void GidQt5Serial::reOpen()
+bool GidQt5Serial::reOpen()
 {
     if (s.isOpen()) {
         s.close();
     }
-    openSerialPort();
+    return openSerialPort();
 }
 
 QMap<QString, QString> GidQt5Serial::getSettings()
@@ -164,6 +437,11 @@ QMap<QString, QString> GidQt5Serial::getSettings()
     s.insert("parityIndex", QString::number(ui->comboBox_Parity->currentIndex()));
     s.insert("databits", QString::number(ui->spinBox_DataBits->value()));
     s.insert("stopbitsIndex", QString::number(ui->comboBox_StopBits->currentIndex()));
+    s.insert("flowControlIndex", QString::number(ui->comboBox_FlowControl->currentIndex()));
+
+    foreach (QString key, mPortProfiles.keys()) {
+        s.insert(key, mPortProfiles.value(key));
+    }
 
     return s;
 }
@@ -182,6 +460,15 @@ void GidQt5Serial::setSettings(QMap<QString, QString> settings)
     ui->comboBox_StopBits->setCurrentIndex(settings.value("stopbitsIndex",
                 QString::number(ui->comboBox_StopBits->currentIndex())).toInt());
 
+    ui->comboBox_FlowControl->setCurrentIndex(settings.value("flowControlIndex",
+                QString::number(ui->comboBox_FlowControl->currentIndex())).toInt());
+
+    foreach (QString key, settings.keys()) {
+        if (key.startsWith("ports/")) {
+            mPortProfiles.insert(key, settings.value(key));
+        }
+    }
+    loadPortProfile(ui->lineEdit_PortName->text());
 }
 
 void GidQt5Serial::setPort(QString port)
@@ -210,21 +497,15 @@ void GidQt5Serial::setStopBits(QSerialPort::StopBits stopBits)
                 QVariant::fromValue(stopBits).toString());
 }
 
-void GidQt5Serial::on_pushButton_OpenPort_clicked()
+void GidQt5Serial::setFlowControl(QSerialPort::FlowControl flowControl)
 {
-    if (ui->lineEdit_PortName->text().isEmpty()) {
-        ui->label_PortStatus->setText("Specify a serial port.");
-        return;
-    }
-    ui->label_PortStatus->clear();
-
-    if (s.isOpen()) {
-        s.close();
-    }
-
-    s.setPortName(ui->lineEdit_PortName->text());
+    ui->comboBox_FlowControl->setCurrentText(
+                QVariant::fromValue(flowControl).toString());
+}
 
-    openSerialPort();
+void GidQt5Serial::on_pushButton_OpenPort_clicked()
+{
+    open();
 }
 
 void GidQt5Serial::on_pushButton_RefreshPorts_clicked()
@@ -245,11 +526,19 @@ void GidQt5Serial::on_listWidget_Ports_itemDoubleClicked(QListWidgetItem* /*item
 
 void GidQt5Serial::on_listWidget_Ports_itemClicked(QListWidgetItem *item)
 {
-    ui->lineEdit_PortName->setText(
-                serialPortList.value(ui->listWidget_Ports->row(item)).portName());
+    QString name = serialPortList.value(ui->listWidget_Ports->row(item)).portName();
+    ui->lineEdit_PortName->setText(name);
+    // Checking opens the port, which can take long, so only the clicked port
+    // is checked
+    mPortWatcher.checkBusy(name);
 }
 
 void GidQt5Serial::on_lineEdit_PortName_returnPressed()
 {
     on_pushButton_OpenPort_clicked();
 }
+
+void GidQt5Serial::on_lineEdit_PortName_textChanged(const QString& text)
+{
+    loadPortProfile(text);
+}
@@ -21,7 +21,11 @@
 #ifndef GIDQT5SERIAL_H
 #define GIDQT5SERIAL_H
 
+#include "gidserialportwatcher.h"
+
+#include <QBasicTimer>
 #include <QCloseEvent>
+#include <QElapsedTimer>
 #include <QListWidgetItem>
 #include <QMainWindow>
 #include <QMap>
@@ -42,9 +46,12 @@ public:
     ~GidQt5Serial();
 
     void refreshSerialPortList();
+    GidSerialPortWatcher* portWatcher() { return &mPortWatcher; }
     QSerialPort s;
-    void open();
-    void reOpen();
+    // Opens the port with the dialog's settings. Returns true if opened.
+    bool open();
+    // Returns true if the port was opened
+    bool reOpen();
 
     QMap<QString, QString> getSettings();
     void setSettings(QMap<QString, QString> settings);
@@ -54,6 +61,29 @@ public:
     void setParity(QSerialPort::Parity parity);
     void setDataBits(QSerialPort::DataBits dataBits);
     void setStopBits(QSerialPort::StopBits stopBits);
+    void setFlowControl(QSerialPort::FlowControl flowControl);
+
+    static const int minBaudRate = 50;
+    static const int maxBaudRate = 20000000;
+
+    // Bits on the line per character, including start, parity and stop bits
+    double bitsPerCharacter();
+    // Maximum characters (bytes) per second in each direction
+    double lineCapacity();
+
+    // Receive coalescing window of the open port, 0 if off
+    int coalesceMs() { return mCoalesceMs; }
+
+    /* Flow control stalls of the open port. Transmission is blocked when CTS
+     * is deasserted (hardware flow control) or, on Linux, when the driver's
+     * output queue stops draining. The driver consumes XOFF characters, so
+     * with software flow control each stall is counted as an XOFF. */
+    struct FlowControlStats {
+        qint64 blockedUs = 0;
+        quint64 stalls = 0;
+        bool blocked = false;
+    };
+    const FlowControlStats& flowControlStats() { return mFlowStats; }
 
 signals:
     void print(QString msg);
@@ -65,12 +95,38 @@ private:
 
     void closeEvent(QCloseEvent *event);
     void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
 
+    GidSerialPortWatcher mPortWatcher;
     QList<QSerialPortInfo> serialPortList;
+    void updateSerialPortList();
+    void onPortBusyChecked(QString portName, bool busy);
     QList<QSerialPort::Parity> parityComboBoxList;
     QList<QSerialPort::StopBits> stopBitsComboBoxList;
-
-    void openSerialPort();
+    QList<QSerialPort::FlowControl> flowControlComboBoxList;
+
+    bool openSerialPort();
+    void verifyBaudRate(int baud);
+    void enableLowLatency();
+
+    FlowControlStats mFlowStats;
+    QBasicTimer mFlowTimer;
+    QElapsedTimer mFlowClock;
+    qint64 mFlowLastPollUs = 0;
+    qint64 mFlowLastDrainUs = 0;
+    int mFlowLastOutQueue = 0;
+    qint64 mFlowWrittenSincePoll = 0;
+    void startFlowControlMonitor();
+    void pollFlowControl();
+    void timerEvent(QTimerEvent* event) override;
+
+    /* Receive options are saved per port, as "ports/<port>/<option>" in the
+     * settings map. */
+    QMap<QString, QString> mPortProfiles;
+    int mCoalesceMs = 0;
+    static QString portProfileKey(QString port, QString option);
+    void loadPortProfile(QString port);
+    void savePortProfile(QString port);
 
 private slots:
     void on_pushButton_OpenPort_clicked();
@@ -79,6 +135,7 @@ private slots:
     void on_listWidget_Ports_itemDoubleClicked(QListWidgetItem *item);
     void on_listWidget_Ports_itemClicked(QListWidgetItem *item);
     void on_lineEdit_PortName_returnPressed();
+    void on_lineEdit_PortName_textChanged(const QString& text);
 };
 
 #endif // GIDQT5SERIAL_H
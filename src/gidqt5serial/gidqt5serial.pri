@@ -5,6 +5,7 @@
 # By including this .pri file, the following is automatically done:
 
 #   - The serialport module is added to QT, which is required to use QSerialPort.
+#     The concurrent module is added for enumerating ports in the background.
 
 #   - The GidQt5Serial header, source and form files are added to your project
 #     so they will be included in your build.
@@ -16,17 +17,19 @@
 # 
 
 
-QT += serialport
+QT += serialport concurrent
 
 GIDQT5SERIAL_DIR = $$PWD
 
 INCLUDEPATH += $${GIDQT5SERIAL_DIR}
 
 SOURCES += \
-    $${GIDQT5SERIAL_DIR}/gidqt5serial.cpp
+    $${GIDQT5SERIAL_DIR}/gidqt5serial.cpp \
+    $${GIDQT5SERIAL_DIR}/gidserialportwatcher.cpp
 
 HEADERS += \
-    $${GIDQT5SERIAL_DIR}/gidqt5serial.h
+    $${GIDQT5SERIAL_DIR}/gidqt5serial.h \
+    $${GIDQT5SERIAL_DIR}/gidserialportwatcher.h
 
 FORMS += \
     $${GIDQT5SERIAL_DIR}/gidqt5serial.ui
@@ -0,0 +1,151 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidserialportwatcher.h"
+
+#include <QSet>
+#include <QtConcurrent>
+
+#ifdef Q_OS_LINUX
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+
+GidSerialPortWatcher::GidSerialPortWatcher(QObject *parent) : QObject(parent)
+{
+    connect(&mEnumWatcher, &QFutureWatcher<QList<QSerialPortInfo>>::finished,
+            this, &GidSerialPortWatcher::onEnumFinished);
+    setupHotplug();
+}
+
+GidSerialPortWatcher::~GidSerialPortWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (mUeventSocket >= 0) { close(mUeventSocket); }
+#endif
+}
+
+void GidSerialPortWatcher::refresh()
+{
+    if (mEnumWatcher.isRunning()) {
+        mRefreshPending = true;
+        return;
+    }
+    mEnumWatcher.setFuture(QtConcurrent::run(&QSerialPortInfo::availablePorts));
+}
+
+void GidSerialPortWatcher::onEnumFinished()
+{
+    QSet<QString> before;
+    foreach (const QSerialPortInfo& info, mPorts) {
+        before.insert(info.portName());
+    }
+    mPorts = mEnumWatcher.result();
+    emit portsChanged();
+    foreach (const QSerialPortInfo& info, mPorts) {
+        if (!before.contains(info.portName())) { emit portAdded(info.portName()); }
+    }
+
+    if (mRefreshPending) {
+        mRefreshPending = false;
+        refresh();
+    }
+}
+
+void GidSerialPortWatcher::setAutoRefresh(bool enable)
+{
+    // Hotplug events make polling unnecessary
+    if (enable && !mUeventNotifier) {
+        mPollTimer.start(pollIntervalMs, this);
+    } else {
+        mPollTimer.stop();
+    }
+}
+
+void GidSerialPortWatcher::checkBusy(QString portName)
+{
+    QSerialPortInfo info;
+    foreach (const QSerialPortInfo& p, mPorts) {
+        if (p.portName() == portName) { info = p; break; }
+    }
+    if (info.isNull()) { return; }
+
+    auto watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [=]()
+    {
+        emit busyChecked(portName, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([info]() { return info.isBusy(); }));
+}
+
+void GidSerialPortWatcher::setupHotplug()
+{
+#ifdef Q_OS_LINUX
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                    NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) { return; }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; // Kernel uevents
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return;
+    }
+
+    mUeventSocket = fd;
+    mUeventNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(mUeventNotifier, &QSocketNotifier::activated,
+            this, &GidSerialPortWatcher::onUevent);
+#endif
+}
+
+/* A uevent is "action@devpath" followed by KEY=value strings, all separated by
+ * null characters. */
+void GidSerialPortWatcher::onUevent()
+{
+#ifdef Q_OS_LINUX
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(mUeventSocket, buf, sizeof(buf), 0)) > 0) {
+        QList<QByteArray> fields = QByteArray(buf, int(n)).split('\0');
+        bool tty = fields.contains("SUBSYSTEM=tty");
+        bool addOrRemove = fields.contains("ACTION=add")
+                || fields.contains("ACTION=remove");
+        if (tty && addOrRemove) {
+            mHotplugTimer.start(hotplugDelayMs, this);
+        }
+    }
+#endif
+}
+
+void GidSerialPortWatcher::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == mHotplugTimer.timerId()) {
+        mHotplugTimer.stop();
+        refresh();
+    } else if (event->timerId() == mPollTimer.timerId()) {
+        refresh();
+    }
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDSERIALPORTWATCHER_H
+#define GIDSERIALPORTWATCHER_H
+
+#include <QBasicTimer>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QSerialPortInfo>
+#include <QSocketNotifier>
+
+/* GidSerialPortWatcher keeps a list of available serial ports without
+ * blocking the GUI thread.
+ *
+ * Ports are enumerated in a background thread. On Linux, the list is
+ * refreshed when the kernel reports tty devices being added or removed
+ * (uevents over netlink, so udev is not needed). On other platforms, the list
+ * is polled while auto refresh is enabled.
+ *
+ * Checking whether a port is busy means opening it, so it is not done while
+ * enumerating but only on request with checkBusy(). */
+class GidSerialPortWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GidSerialPortWatcher(QObject *parent = 0);
+    ~GidSerialPortWatcher();
+
+    void refresh();
+    QList<QSerialPortInfo> ports() const { return mPorts; }
+    void setAutoRefresh(bool enable);
+    void checkBusy(QString portName);
+
+signals:
+    void portsChanged();
+    void portAdded(QString portName);
+    void busyChecked(QString portName, bool busy);
+
+private:
+    QList<QSerialPortInfo> mPorts;
+    QFutureWatcher<QList<QSerialPortInfo>> mEnumWatcher;
+    bool mRefreshPending = false;
+    void onEnumFinished();
+
+    // Hotplug events come in bursts and before device nodes are ready, so
+    // refreshing is delayed a little.
+    static const int hotplugDelayMs = 300;
+    static const int pollIntervalMs = 2000;
+    QBasicTimer mHotplugTimer;
+    QBasicTimer mPollTimer;
+    int mUeventSocket = -1;
+    QSocketNotifier* mUeventNotifier = nullptr;
+    void setupHotplug();
+    void onUevent();
+    void timerEvent(QTimerEvent* event) override;
+};
+
+#endif // GIDSERIALPORTWATCHER_H
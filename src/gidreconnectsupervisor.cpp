@@ -0,0 +1,87 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidreconnectsupervisor.h"
+
+#include <QRandomGenerator>
+#include <QTimerEvent>
+
+
+GidReconnectSupervisor::GidReconnectSupervisor(QObject *parent) : QObject(parent)
+{
+}
+
+void GidReconnectSupervisor::setEnabled(bool enable)
+{
+    mEnabled = enable;
+    if (!enable) { stop(); }
+}
+
+void GidReconnectSupervisor::connectionLost()
+{
+    if (!mEnabled) { return; }
+    if (!mDown) {
+        mDown = true;
+        mAttempt = 0;
+        mDownClock.start();
+    }
+
+    int shift = qMin(mAttempt, 16);
+    int delay = int(qMin(qint64(mMaxDelayMs), qint64(initialDelayMs) << shift));
+    delay -= QRandomGenerator::global()->bounded(delay / 2 + 1);
+    mNextDelayMs = delay;
+    mTimer.start(delay, this);
+}
+
+void GidReconnectSupervisor::connected()
+{
+    mTimer.stop();
+    if (!mDown) { return; }
+    mDown = false;
+    qint64 us = mDownClock.nsecsElapsed() / 1000;
+    mReconnects++;
+    mDowntimeUs += us;
+    emit reconnected(us);
+}
+
+void GidReconnectSupervisor::retryNow()
+{
+    if (!mDown) { return; }
+    mTimer.start(0, this);
+}
+
+void GidReconnectSupervisor::stop()
+{
+    mTimer.stop();
+    mDown = false;
+}
+
+qint64 GidReconnectSupervisor::currentDowntimeUs() const
+{
+    return mDown ? (mDownClock.nsecsElapsed() / 1000) : 0;
+}
+
+void GidReconnectSupervisor::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() != mTimer.timerId()) { return; }
+    mTimer.stop();
+    mAttempt++;
+    emit attempt();
+}
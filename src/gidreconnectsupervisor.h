@@ -0,0 +1,80 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDRECONNECTSUPERVISOR_H
+#define GIDRECONNECTSUPERVISOR_H
+
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QObject>
+
+/* GidReconnectSupervisor schedules reconnect attempts for a connection that
+ * was lost, without blocking the event loop.
+ *
+ * Call connectionLost() when the connection drops and again whenever an
+ * attempt fails. The attempt() signal is emitted after a delay that doubles
+ * with every failed attempt, from initialDelayMs up to maxDelayMs, with a
+ * random jitter of up to half the delay so devices that drop together don't
+ * reconnect in lockstep. Call connected() when the connection is up again.
+ * retryNow() attempts immediately, e.g. when a device reappears. */
+class GidReconnectSupervisor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GidReconnectSupervisor(QObject *parent = 0);
+
+    void setEnabled(bool enable);
+    bool isEnabled() const { return mEnabled; }
+    void setMaxDelayMs(int ms) { mMaxDelayMs = qMax(initialDelayMs, ms); }
+
+    void connectionLost();
+    void connected();
+    void retryNow();
+    // Stops attempting, e.g. when the user closes the connection
+    void stop();
+
+    bool isDown() const { return mDown; }
+    int attemptCount() const { return mAttempt; }
+    int nextDelayMs() const { return mNextDelayMs; }
+    qint64 reconnectCount() const { return mReconnects; }
+    // Total downtime of outages that ended in a reconnect
+    qint64 downtimeUs() const { return mDowntimeUs; }
+    // Duration of the current outage, 0 if connected
+    qint64 currentDowntimeUs() const;
+
+signals:
+    void attempt();
+    void reconnected(qint64 downtimeUs);
+
+private:
+    static const int initialDelayMs = 250;
+    bool mEnabled = false;
+    int mMaxDelayMs = 30000;
+    bool mDown = false;
+    int mAttempt = 0;
+    int mNextDelayMs = 0;
+    qint64 mReconnects = 0;
+    qint64 mDowntimeUs = 0;
+    QElapsedTimer mDownClock;
+    QBasicTimer mTimer;
+    void timerEvent(QTimerEvent* event) override;
+};
+
+#endif // GIDRECONNECTSUPERVISOR_H
@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidsettings.h"
+
+#include <QTimerEvent>
+#include <QtConcurrent>
+
+
+GidSettings::GidSettings(QSettings::Format format, QSettings::Scope scope,
+                         QString organization, QString application,
+                         QObject *parent) :
+    QObject(parent),
+    mFormat(format),
+    mScope(scope),
+    mOrganization(organization),
+    mApplication(application)
+{
+    QSettings s(mFormat, mScope, mOrganization, mApplication);
+    mFileName = s.fileName();
+    foreach (QString key, s.allKeys()) {
+        mValues.insert(key, s.value(key));
+    }
+
+    connect(&mFlushWatcher, &QFutureWatcher<void>::finished, this, [=]()
+    {
+        // Changes made while writing
+        if (!mDirty.isEmpty() && !mFlushTimer.isActive()) { startFlush(); }
+    });
+}
+
+GidSettings::~GidSettings()
+{
+    flush();
+}
+
+QString GidSettings::fullKey(QString key) const
+{
+    if (mGroups.isEmpty()) { return key; }
+    return mGroups.join('/') + '/' + key;
+}
+
+QVariant GidSettings::value(QString key, const QVariant& defaultValue) const
+{
+    return mValues.value(fullKey(key), defaultValue);
+}
+
+void GidSettings::setValue(QString key, const QVariant& value)
+{
+    key = fullKey(key);
+    auto it = mValues.find(key);
+    if ((it != mValues.end()) && (it.value() == value)) { return; }
+    mValues.insert(key, value);
+    mDirty.insert(key, value);
+
+    // Wait until changes settle, but don't postpone writing indefinitely
+    if (!mFlushTimer.isActive()) {
+        mDirtyClock.start();
+        mFlushTimer.start(flushDelayMs, this);
+    } else if (mDirtyClock.elapsed() + flushDelayMs < maxFlushDelayMs) {
+        mFlushTimer.start(flushDelayMs, this);
+    }
+}
+
+void GidSettings::beginGroup(QString prefix)
+{
+    mGroups.append(prefix);
+}
+
+void GidSettings::endGroup()
+{
+    if (!mGroups.isEmpty()) { mGroups.removeLast(); }
+}
+
+QStringList GidSettings::allKeys() const
+{
+    if (mGroups.isEmpty()) { return mValues.keys(); }
+
+    QString prefix = mGroups.join('/') + '/';
+    QStringList ret;
+    // Keys are sorted, so the group's keys are together
+    for (auto it = mValues.lowerBound(prefix); it != mValues.end(); ++it) {
+        if (!it.key().startsWith(prefix)) { break; }
+        ret.append(it.key().mid(prefix.length()));
+    }
+    return ret;
+}
+
+void GidSettings::startFlush()
+{
+    mFlushTimer.stop();
+    // One write at a time so changes are written in order. The rest is
+    // written when the current write finishes.
+    if (mFlushWatcher.isRunning() || mDirty.isEmpty()) { return; }
+
+    QMap<QString, QVariant> values = mDirty;
+    mDirty.clear();
+    mFlushWatcher.setFuture(QtConcurrent::run([=]() { write(values); }));
+}
+
+void GidSettings::flush()
+{
+    mFlushTimer.stop();
+    mFlushWatcher.waitForFinished();
+    if (mDirty.isEmpty()) { return; }
+    write(mDirty);
+    mDirty.clear();
+}
+
+/* QSettings is reentrant, so a separate instance is used in each thread. */
+void GidSettings::write(QMap<QString, QVariant> values) const
+{
+    QSettings s(mFormat, mScope, mOrganization, mApplication);
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+        s.setValue(it.key(), it.value());
+    }
+    s.sync();
+}
+
+void GidSettings::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == mFlushTimer.timerId()) {
+        startFlush();
+    }
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDSETTINGS_H
+#define GIDSETTINGS_H
+
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QMap>
+#include <QObject>
+#include <QSettings>
+#include <QStringList>
+#include <QVariant>
+
+/* GidSettings is a write-behind cache in front of QSettings.
+ *
+ * All settings are read once when constructed and kept in memory, so value()
+ * never touches the disk. setValue() only updates memory and marks the key
+ * dirty. Dirty keys are written in a background thread once no changes were
+ * made for flushDelayMs (or at most every maxFlushDelayMs while changes keep
+ * coming), and synchronously by flush() and when destroyed.
+ *
+ * Groups work as in QSettings, with keys separated by '/'. */
+class GidSettings : public QObject
+{
+    Q_OBJECT
+public:
+    GidSettings(QSettings::Format format, QSettings::Scope scope,
+                QString organization, QString application,
+                QObject *parent = 0);
+    ~GidSettings();
+
+    QVariant value(QString key, const QVariant& defaultValue = QVariant()) const;
+    void setValue(QString key, const QVariant& value);
+    void beginGroup(QString prefix);
+    void endGroup();
+    // Keys in the current group, relative to the group
+    QStringList allKeys() const;
+    QString fileName() const { return mFileName; }
+
+    // Writes dirty keys and waits until they are written
+    void flush();
+
+private:
+    static const int flushDelayMs = 1000;
+    static const int maxFlushDelayMs = 5000;
+
+    const QSettings::Format mFormat;
+    const QSettings::Scope mScope;
+    const QString mOrganization;
+    const QString mApplication;
+    QString mFileName;
+
+    QMap<QString, QVariant> mValues;
+    QMap<QString, QVariant> mDirty;
+    QStringList mGroups;
+    QString fullKey(QString key) const;
+
+    QBasicTimer mFlushTimer;
+    QElapsedTimer mDirtyClock;
+    QFutureWatcher<void> mFlushWatcher;
+    void startFlush();
+    void write(QMap<QString, QVariant> values) const;
+    void timerEvent(QTimerEvent* event) override;
+};
+
+#endif // GIDSETTINGS_H
@@ -0,0 +1,57 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidsocketoptions.h"
+
+
+void GidSocketOptions::apply(QAbstractSocket* socket) const
+{
+    if (socket->socketType() == QAbstractSocket::TcpSocket) {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, noDelay ? 1 : 0);
+        socket->setSocketOption(QAbstractSocket::KeepAliveOption, keepAlive ? 1 : 0);
+    }
+    if (receiveBufferSize > 0) {
+        socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption,
+                                receiveBufferSize);
+    }
+    if (sendBufferSize > 0) {
+        socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption,
+                                sendBufferSize);
+    }
+    if (typeOfService >= 0) {
+        socket->setSocketOption(QAbstractSocket::TypeOfServiceOption, typeOfService);
+    }
+}
+
+QString GidSocketOptions::describe(QAbstractSocket* socket)
+{
+    QString ret;
+    if (socket->socketType() == QAbstractSocket::TcpSocket) {
+        ret += QString("no delay %1, keepalive %2, ")
+                .arg(socket->socketOption(QAbstractSocket::LowDelayOption).toInt() ? "on" : "off")
+                .arg(socket->socketOption(QAbstractSocket::KeepAliveOption).toInt() ? "on" : "off");
+    }
+    ret += QString("receive buffer %1, send buffer %2, TOS 0x%3")
+            .arg(socket->socketOption(QAbstractSocket::ReceiveBufferSizeSocketOption).toInt())
+            .arg(socket->socketOption(QAbstractSocket::SendBufferSizeSocketOption).toInt())
+            .arg(socket->socketOption(QAbstractSocket::TypeOfServiceOption).toInt(),
+                 2, 16, QChar('0'));
+    return ret;
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDSOCKETOPTIONS_H
+#define GIDSOCKETOPTIONS_H
+
+#include <QAbstractSocket>
+#include <QString>
+
+/* Socket tuning options for TCP and UDP sockets. The options can only be set
+ * once a socket is connected or bound, so apply() is called then. TCP-only
+ * options are ignored for UDP sockets. */
+struct GidSocketOptions
+{
+    // Disable Nagle's algorithm so small messages are sent immediately
+    bool noDelay = false;
+    bool keepAlive = false;
+    // Buffer sizes in bytes, 0 for the system default
+    int receiveBufferSize = 0;
+    int sendBufferSize = 0;
+    // IP type of service byte (DSCP and ECN), -1 for the system default
+    int typeOfService = -1;
+
+    void apply(QAbstractSocket* socket) const;
+    // Effective options of the socket. The system may round or double
+    // requested buffer sizes.
+    static QString describe(QAbstractSocket* socket);
+};
+
+#endif // GIDSOCKETOPTIONS_H
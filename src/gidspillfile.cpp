@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidspillfile.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+
+GidSpillFile::~GidSpillFile()
+{
+    unmap();
+}
+
+bool GidSpillFile::append(const Record& record)
+{
+    if (!mFile.isOpen() && !mFile.open()) { return false; }
+
+    QByteArray tag = record.chunk.tag.toUtf8().left(0xFFFF);
+    const QByteArray& data = record.chunk.data;
+
+    uchar header[headerSize];
+    qToLittleEndian<quint64>(record.seq, header);
+    qToLittleEndian<qint64>(record.chunk.timestamp.monotonicUs(), header + 8);
+    qToLittleEndian<quint32>(quint32(data.count()), header + 16);
+    qToLittleEndian<quint16>(quint16(tag.count()), header + 20);
+    header[22] = (record.chunk.frameStart ? 1 : 0) | quint8(record.kind << 1);
+    qToLittleEndian<qint64>(record.gapBytes, header + 23);
+
+    mFile.seek(mWritePos);
+    bool ok = (mFile.write((const char*)header, headerSize) == headerSize)
+            && (mFile.write(tag) == tag.count())
+            && (mFile.write(data) == data.count());
+    if (!ok) {
+        // Leave out the partly written record
+        mFile.seek(mWritePos);
+        return false;
+    }
+    mWritePos += headerSize + tag.count() + data.count();
+    mChunks++;
+    mBytes += data.count();
+    mGapBytes += record.gapBytes;
+    return true;
+}
+
+bool GidSpillFile::takeFirst(Record* record)
+{
+    if (isEmpty()) { return false; }
+
+    const uchar* header = map(mReadPos, headerSize);
+    if (!header) { return false; }
+    quint32 dataSize = qFromLittleEndian<quint32>(header + 16);
+    quint16 tagSize = qFromLittleEndian<quint16>(header + 20);
+    quint8 flags = header[22];
+    record->seq = qFromLittleEndian<quint64>(header);
+    qint64 us = qFromLittleEndian<qint64>(header + 8);
+    record->gapBytes = qFromLittleEndian<qint64>(header + 23);
+
+    const uchar* p = map(mReadPos, headerSize + tagSize + dataSize);
+    if (!p) { return false; }
+    p += headerSize;
+    record->chunk = GidChunk(QByteArray((const char*)p + tagSize, int(dataSize)),
+                             GidTimestamp::fromMonotonicUs(us), flags & 1);
+    record->chunk.tag = QString::fromUtf8((const char*)p, tagSize);
+    record->kind = flags >> 1;
+
+    mReadPos += headerSize + tagSize + dataSize;
+    mChunks--;
+    mBytes -= dataSize;
+    mGapBytes -= record->gapBytes;
+    if (isEmpty()) { clear(); }
+    return true;
+}
+
+void GidSpillFile::clear()
+{
+    unmap();
+    if (mFile.isOpen()) { mFile.resize(0); }
+    mReadPos = 0;
+    mWritePos = 0;
+    mChunks = 0;
+    mBytes = 0;
+    mGapBytes = 0;
+}
+
+/* Returns a pointer to size bytes from pos in the file. The mapped window
+ * covers up to windowSize bytes from pos and is only moved when the range is
+ * outside of it. */
+const uchar* GidSpillFile::map(qint64 pos, qint64 size)
+{
+    if (mMap && (pos >= mMapPos) && (pos + size <= mMapPos + mMapSize)) {
+        return mMap + (pos - mMapPos);
+    }
+    unmap();
+    // Written data must reach the file before it can be mapped
+    mFile.flush();
+    qint64 mapSize = qMin(qMax(size, windowSize), mWritePos - pos);
+    if (mapSize < size) { return nullptr; }
+    mMap = mFile.map(pos, mapSize);
+    if (!mMap) { return nullptr; }
+    mMapPos = pos;
+    mMapSize = mapSize;
+    return mMap;
+}
+
+void GidSpillFile::unmap()
+{
+    if (mMap) {
+        mFile.unmap(mMap);
+        mMap = nullptr;
+    }
+}
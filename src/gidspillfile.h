@@ -0,0 +1,76 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDSPILLFILE_H
+#define GIDSPILLFILE_H
+
+#include "gidchunk.h"
+
+#include <QTemporaryFile>
+
+/* GidSpillFile keeps chunks that don't fit in memory in a temporary file, in
+ * the order they were added. Chunks are read back from the front through a
+ * memory-mapped window of the file, so reading doesn't copy the file through
+ * an extra buffer. The file is truncated when all chunks have been read. */
+class GidSpillFile
+{
+public:
+    struct Record {
+        quint64 seq;
+        GidChunk chunk;
+        // Kind of chunk, defined by the caller (0 to 127)
+        quint8 kind;
+        // Bytes dropped right before this chunk
+        qint64 gapBytes;
+    };
+
+    ~GidSpillFile();
+
+    bool append(const Record& record);
+    bool takeFirst(Record* record);
+    void clear();
+
+    bool isEmpty() const { return mChunks == 0; }
+    int chunks() const { return mChunks; }
+    // Data bytes of the chunks in the file
+    qint64 bytes() const { return mBytes; }
+    qint64 gapBytes() const { return mGapBytes; }
+    QString errorString() const { return mFile.errorString(); }
+
+private:
+    // seq, timestamp, data length, tag length, flags, gap bytes
+    static const int headerSize = 8 + 8 + 4 + 2 + 1 + 8;
+    static const qint64 windowSize = 4 * 1024 * 1024;
+
+    QTemporaryFile mFile;
+    qint64 mReadPos = 0;
+    qint64 mWritePos = 0;
+    int mChunks = 0;
+    qint64 mBytes = 0;
+    qint64 mGapBytes = 0;
+
+    uchar* mMap = nullptr;
+    qint64 mMapPos = 0;
+    qint64 mMapSize = 0;
+    const uchar* map(qint64 pos, qint64 size);
+    void unmap();
+};
+
+#endif // GIDSPILLFILE_H
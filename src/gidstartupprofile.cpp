@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidstartupprofile.h"
+
+#include <iostream>
+
+
+QElapsedTimer GidStartupProfile::clock;
+QList<GidStartupProfile::Phase> GidStartupProfile::phases;
+bool GidStartupProfile::enabled = false;
+
+void GidStartupProfile::start()
+{
+    clock.start();
+    phases.clear();
+}
+
+void GidStartupProfile::setEnabled(bool enable)
+{
+    if (enable && !enabled) {
+        for (int i = 0; i < phases.count(); i++) { printPhase(i); }
+    }
+    enabled = enable;
+}
+
+void GidStartupProfile::mark(QString phase)
+{
+    if (!clock.isValid()) { return; }
+    phases.append({phase, clock.nsecsElapsed() / 1000});
+    if (enabled) { printPhase(phases.count() - 1); }
+}
+
+void GidStartupProfile::printPhase(int index)
+{
+    const Phase& p = phases.at(index);
+    qint64 delta = p.us - ((index > 0) ? phases.at(index - 1).us : 0);
+    std::cout << QString("[startup] %1 ms (+%2 ms) %3")
+                 .arg(p.us / 1000.0, 8, 'f', 2)
+                 .arg(delta / 1000.0, 0, 'f', 2)
+                 .arg(p.name).toStdString() << std::endl;
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDSTARTUPPROFILE_H
+#define GIDSTARTUPPROFILE_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+/* GidStartupProfile records when startup phases complete, relative to the
+ * start of main(). Phases are always recorded (it is cheap) but only printed
+ * to stdout once enabled, e.g. with the --profile-startup option. Phases
+ * recorded before enabling are printed when enabled. */
+class GidStartupProfile
+{
+public:
+    static void start();
+    static void setEnabled(bool enable);
+    static void mark(QString phase);
+
+private:
+    struct Phase {
+        QString name;
+        qint64 us;
+    };
+    static QElapsedTimer clock;
+    static QList<Phase> phases;
+    static bool enabled;
+    static void printPhase(int index);
+};
+
+#endif // GIDSTARTUPPROFILE_H
@@ -20,6 +20,8 @@
 
 #include "gidtcp.h"
 
+#include <QTimer>
+
 GidTcp::GidTcp(QObject *parent) :
     QObject(parent)
 {
@@ -67,8 +69,12 @@ void GidTcp::connectToServer(QHostAddress address, quint16 port)
     client.reset(new Con());
     client->socket = new QTcpSocket();
 
-    connect(client->socket, &QTcpSocket::connected,
-            this, &GidTcp::clientConnected);
+    connect(client->socket, &QTcpSocket::connected, this, [=]()
+    {
+        mSocketOptions.apply(client->socket);
+        print("Socket options: " + GidSocketOptions::describe(client->socket));
+        emit clientConnected();
+    });
 
     connect(client->socket,
             static_cast<void (QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::error),
@@ -87,16 +93,27 @@ void GidTcp::connectToServer(QHostAddress address, quint16 port)
     client->socket->connectToHost(address, port);
 }
 
+/* Disconnecting does not wait for the socket to close. The socket deletes
+ * itself once disconnected, or is aborted if that takes too long. */
 void GidTcp::disconnectFromServer()
 {
     if (!client) { return; }
-    if (client->socket->isOpen()) {
-        client->socket->blockSignals(true);
-        client->socket->disconnectFromHost();
-        client->socket->waitForDisconnected(1000);
-        client->socket->deleteLater();
-    }
+    QTcpSocket* socket = client->socket;
     client.reset();
+    if (!socket) { return; }
+
+    socket->disconnect(this);
+    if (socket->state() == QAbstractSocket::UnconnectedState) {
+        socket->deleteLater();
+        return;
+    }
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    QTimer::singleShot(disconnectTimeoutMs, socket, [socket]()
+    {
+        socket->abort();
+        socket->deleteLater();
+    });
+    socket->disconnectFromHost();
 }
 
 bool GidTcp::isConnectedToServer()
@@ -112,11 +129,41 @@ bool GidTcp::isConnectedToServer()
     return ret;
 }
 
+QAbstractSocket::SocketState GidTcp::clientState()
+{
+    if (!client || !client->socket) { return QAbstractSocket::UnconnectedState; }
+    return client->socket->state();
+}
+
 QList<GidTcp::ConPtr> GidTcp::serverConnections()
 {
     return mServerConnections;
 }
 
+qint64 GidTcp::bytesToWrite()
+{
+    qint64 ret = 0;
+    if (client && client->socket) {
+        ret = client->socket->bytesToWrite();
+    }
+    foreach (ConPtr con, mServerConnections) {
+        ret = qMax(ret, con->socket->bytesToWrite());
+    }
+    return ret;
+}
+
+void GidTcp::setSocketOptions(GidSocketOptions options)
+{
+    mSocketOptions = options;
+    if (client && client->socket
+            && (client->socket->state() == QAbstractSocket::ConnectedState)) {
+        options.apply(client->socket);
+    }
+    foreach (ConPtr con, mServerConnections) {
+        options.apply(con->socket);
+    }
+}
+
 QString GidTcp::ipString(QHostAddress a)
 {
     static QString toRemove = "::ffff:";
@@ -134,6 +181,7 @@ void GidTcp::onServerNewTcpConnection()
         ConPtr con(new Con());
         con->socket = tcpServer.nextPendingConnection();
         con->id = socketIdCounter++;
+        mSocketOptions.apply(con->socket);
         mServerConnections.append(con);
 
         // Weak pointer to prevent memory leak with lambda
@@ -21,6 +21,8 @@
 #ifndef GIDTCP_H
 #define GIDTCP_H
 
+#include "gidsocketoptions.h"
+
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
@@ -48,10 +50,19 @@ public:
     void connectToServer(QHostAddress address, quint16 port);
     void disconnectFromServer();
     bool isConnectedToServer();
+    QAbstractSocket::SocketState clientState();
 
     int serverConnectionCount();
     QList<ConPtr> serverConnections();
 
+    // Bytes not yet written to the client socket, or the most of all server
+    // connections
+    qint64 bytesToWrite();
+
+    // Applied to the client socket and server connections, including those
+    // already connected
+    void setSocketOptions(GidSocketOptions options);
+
     static QString ipString(QHostAddress a);
 
 signals:
@@ -73,6 +84,8 @@ private:
     QList<ConPtr> mServerConnections;
     int socketIdCounter = 0;
     ConPtr client;
+    static const int disconnectTimeoutMs = 1000;
+    GidSocketOptions mSocketOptions;
 
 private slots:
     void onServerNewTcpConnection();
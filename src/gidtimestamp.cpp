@@ -0,0 +1,83 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "gidtimestamp.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+
+
+namespace {
+
+struct Anchor
+{
+    Anchor()
+    {
+        clock.start();
+        epochUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    }
+    QElapsedTimer clock;
+    qint64 epochUs = 0;
+};
+
+Anchor& anchor()
+{
+    // Initialised on first use, thread-safe since C++11
+    static Anchor a;
+    return a;
+}
+
+} // namespace
+
+GidTimestamp GidTimestamp::now()
+{
+    GidTimestamp t;
+    t.mUs = anchor().clock.nsecsElapsed() / 1000;
+    return t;
+}
+
+GidTimestamp GidTimestamp::fromMonotonicUs(qint64 us)
+{
+    GidTimestamp t;
+    t.mUs = us;
+    return t;
+}
+
+qint64 GidTimestamp::wallClockUs() const
+{
+    return anchor().epochUs + mUs;
+}
+
+void GidTimestampFormatter::appendTo(QString& out, const GidTimestamp& t)
+{
+    qint64 us = t.wallClockUs();
+    qint64 second = us / 1000000;
+    if (second != mSecond) {
+        mSecond = second;
+        mPrefix = QDateTime::fromMSecsSinceEpoch(second * 1000)
+                  .toString("hh:mm:ss:");
+    }
+    int ms = (us % 1000000) / 1000;
+
+    out += mPrefix;
+    out += QChar('0' + ms / 100);
+    out += QChar('0' + (ms / 10) % 10);
+    out += QChar('0' + ms % 10);
+}
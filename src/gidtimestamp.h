@@ -0,0 +1,61 @@
+/******************************************************************************
+ *
+ * This file is part of SimpleSerial.
+ * Copyright (C) 2024 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef GIDTIMESTAMP_H
+#define GIDTIMESTAMP_H
+
+#include <QString>
+
+/* GidTimestamp is a point in time with microsecond resolution taken from a
+ * monotonic clock. The monotonic clock is anchored to the wall clock once, at
+ * first use, so timestamps can also be shown as time of day without being
+ * affected by wall clock adjustments in between. */
+class GidTimestamp
+{
+public:
+    static GidTimestamp now();
+    static GidTimestamp fromMonotonicUs(qint64 us);
+
+    bool isValid() const { return mUs >= 0; }
+    // Microseconds on the monotonic clock since the anchor
+    qint64 monotonicUs() const { return mUs; }
+    // Microseconds since the Unix epoch
+    qint64 wallClockUs() const;
+    // Microseconds from this timestamp to other
+    qint64 usecsTo(const GidTimestamp& other) const { return other.mUs - mUs; }
+
+private:
+    qint64 mUs = -1;
+};
+
+/* Formats timestamps as local time hh:mm:ss:zzz. The hh:mm:ss part is only
+ * rendered when the second changes. The milliseconds are filled in directly,
+ * so formatting a timestamp is cheap and needs no temporary strings. */
+class GidTimestampFormatter
+{
+public:
+    void appendTo(QString& out, const GidTimestamp& t);
+
+private:
+    qint64 mSecond = -1;
+    QString mPrefix;
+};
+
+#endif // GIDTIMESTAMP_H
@@ -20,6 +20,31 @@
 
 #include "gidudp.h"
 
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <string.h>
+#endif
+
+#ifdef Q_OS_LINUX
+struct GidUdp::Batch
+{
+    int fd = -1;
+    QVector<sockaddr_storage> addresses;
+    QVector<mmsghdr> msgs;
+    // Target index of each message
+    QVector<int> msgTargets;
+    // Targets the socket's address family can't send to
+    QVector<int> otherTargets;
+    iovec iov;
+};
+#else
+struct GidUdp::Batch {};
+#endif
+
 GidUdp::GidUdp(QObject *parent) :
     QObject(parent)
 {
@@ -27,26 +52,105 @@ GidUdp::GidUdp(QObject *parent) :
                   this, &GidUdp::udpSocketReadyRead);
 }
 
-bool GidUdp::setupUdp(int port)
+GidUdp::~GidUdp()
+{
+}
+
+bool GidUdp::setupUdp(int port, QHostAddress multicastGroup,
+                      QNetworkInterface multicastInterface)
 {
     udpPort = port;
+    // A new socket may get the same descriptor with another address family
+    mBatch.reset();
 
     print("Setting up UDP");
 
-    if (udpSocket.bind(udpPort, QUdpSocket::ShareAddress
-                                | QUdpSocket::ReuseAddressHint)) {
+    // Multicast groups can only be joined on a socket of the group's family
+    QHostAddress bindAddress = QHostAddress::Any;
+    if (!multicastGroup.isNull()) {
+        bindAddress = (multicastGroup.protocol() == QAbstractSocket::IPv6Protocol)
+                ? QHostAddress::AnyIPv6 : QHostAddress::AnyIPv4;
+    }
+
+    if (udpSocket.bind(bindAddress, udpPort, QUdpSocket::ShareAddress
+                                             | QUdpSocket::ReuseAddressHint)) {
         print(QString("UDP socket bound to port %1").arg(udpPort));
-        return true;
+        applySocketOptions();
     } else {
         print(QString("Failed to bind UDP to port %1").arg(udpPort));
         print("Error string: " + udpSocket.errorString());
         return false;
     }
+
+    if (multicastGroup.isNull()) { return true; }
+
+    bool joined;
+    QString on;
+    if (multicastInterface.isValid()) {
+        joined = udpSocket.joinMulticastGroup(multicastGroup, multicastInterface);
+        udpSocket.setMulticastInterface(multicastInterface);
+        on = multicastInterface.humanReadableName();
+    } else {
+        joined = udpSocket.joinMulticastGroup(multicastGroup);
+        on = "default interface";
+    }
+    if (joined) {
+        print(QString("Joined multicast group %1 on %2")
+              .arg(multicastGroup.toString()).arg(on));
+    } else {
+        print(QString("Failed to join multicast group %1 on %2: %3")
+              .arg(multicastGroup.toString()).arg(on).arg(udpSocket.errorString()));
+    }
+    return joined;
 }
 
 void GidUdp::stopUdp()
 {
     udpSocket.disconnectFromHost();
+    mSocketOptionsApplied = false;
+    mBatch.reset();
+}
+
+void GidUdp::setSocketOptions(GidSocketOptions options)
+{
+    mSocketOptions = options;
+    mSocketOptionsApplied = false;
+    if (udpSocket.state() == QAbstractSocket::BoundState) {
+        applySocketOptions();
+    }
+}
+
+void GidUdp::applySocketOptions()
+{
+    mSocketOptions.apply(&udpSocket);
+    mSocketOptionsApplied = true;
+    print("Socket options: " + GidSocketOptions::describe(&udpSocket));
+}
+
+/* Each line of /proc/net/udp describes a socket. The 10th field is the
+ * socket's inode and the last field its drop count. */
+qint64 GidUdp::kernelDrops()
+{
+#ifdef Q_OS_LINUX
+    if (udpSocket.state() != QAbstractSocket::BoundState) { return -1; }
+    struct stat st;
+    if (fstat(int(udpSocket.socketDescriptor()), &st) != 0) { return -1; }
+    QByteArray inode = QByteArray::number(quint64(st.st_ino));
+
+    const QStringList files {"/proc/net/udp", "/proc/net/udp6"};
+    foreach (QString path, files) {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) { continue; }
+        f.readLine(); // Header
+        while (!f.atEnd()) {
+            QList<QByteArray> fields = f.readLine().simplified().split(' ');
+            if ((fields.count() >= 13) && (fields.at(9) == inode)) {
+                return fields.last().toLongLong();
+            }
+        }
+    }
+#endif
+    return -1;
 }
 
 void GidUdp::udpSocketReadyRead()
@@ -62,8 +166,189 @@ void GidUdp::udpSocketReadyRead()
     }
 }
 
+bool GidUdp::parseTargets(QString text, quint16 defaultPort,
+                          QList<Target>* targets, QString* error)
+{
+    QList<Target> ret;
+    foreach (QString entry, text.split(',')) {
+        entry = entry.trimmed();
+        if (entry.isEmpty()) { continue; }
+
+        QString host = entry;
+        QString portText;
+        if (entry.startsWith('[')) {
+            // [IPv6 address]:port
+            int end = entry.indexOf(']');
+            if (end < 0) {
+                *error = "Missing ] in " + entry;
+                return false;
+            }
+            host = entry.mid(1, end - 1);
+            QString rest = entry.mid(end + 1);
+            if (rest.startsWith(':')) { portText = rest.mid(1); }
+        } else if (entry.count(':') == 1) {
+            // An IPv6 address without brackets has more than one colon
+            int colon = entry.indexOf(':');
+            host = entry.left(colon);
+            portText = entry.mid(colon + 1);
+        }
+
+        Target t;
+        t.address = QHostAddress(host);
+        if (t.address.isNull()) {
+            *error = "Invalid address: " + host;
+            return false;
+        }
+        t.port = defaultPort;
+        if (!portText.isEmpty()) {
+            bool ok;
+            int port = portText.toInt(&ok);
+            if (!ok || (port < 1) || (port > 65535)) {
+                *error = "Invalid port: " + portText;
+                return false;
+            }
+            t.port = quint16(port);
+        }
+        ret.append(t);
+    }
+    if (ret.isEmpty()) {
+        *error = "No address";
+        return false;
+    }
+    *targets = ret;
+    return true;
+}
+
+void GidUdp::setSendTargets(QList<Target> targets)
+{
+    mTargets = targets;
+    mBatch.reset();
+}
+
+void GidUdp::sendToTargets(const QByteArray& msg)
+{
+    int from = 0;
+#ifdef Q_OS_LINUX
+    if (mTargets.count() > 1) {
+        // The socket is bound by the first send if not bound yet
+        if (udpSocket.state() != QAbstractSocket::BoundState) {
+            sendMessage(msg, mTargets.first().address, mTargets.first().port);
+            from = 1;
+        }
+        if (udpSocket.state() == QAbstractSocket::BoundState) {
+            from = sendBatch(msg, from);
+        }
+    }
+#endif
+    for (int i = from; i < mTargets.count(); i++) {
+        sendMessage(msg, mTargets.at(i).address, mTargets.at(i).port);
+    }
+}
+
+#ifdef Q_OS_LINUX
+/* A dual-stack socket (AF_INET6) sends to IPv4 targets at their IPv4-mapped
+ * IPv6 address. An IPv4 socket can't send to IPv6 targets, and link-local
+ * IPv6 targets need a scope, so these are sent through Qt. */
+void GidUdp::buildBatch(int fd)
+{
+    mBatch.reset(new Batch());
+    mBatch->fd = fd;
+
+    sockaddr_storage local;
+    socklen_t localLength = sizeof(local);
+    memset(&local, 0, sizeof(local));
+    getsockname(fd, (sockaddr*)&local, &localLength);
+
+    for (int i = 0; i < mTargets.count(); i++) {
+        const Target& t = mTargets.at(i);
+        sockaddr_storage a;
+        memset(&a, 0, sizeof(a));
+        bool ipv4 = (t.address.protocol() == QAbstractSocket::IPv4Protocol);
+
+        if (local.ss_family == AF_INET6) {
+            if (!ipv4 && !t.address.scopeId().isEmpty()) {
+                mBatch->otherTargets.append(i);
+                continue;
+            }
+            sockaddr_in6* a6 = (sockaddr_in6*)&a;
+            a6->sin6_family = AF_INET6;
+            a6->sin6_port = htons(t.port);
+            if (ipv4) {
+                quint32 v4 = htonl(t.address.toIPv4Address());
+                a6->sin6_addr.s6_addr[10] = 0xFF;
+                a6->sin6_addr.s6_addr[11] = 0xFF;
+                memcpy(&a6->sin6_addr.s6_addr[12], &v4, 4);
+            } else {
+                Q_IPV6ADDR v6 = t.address.toIPv6Address();
+                memcpy(&a6->sin6_addr, &v6, 16);
+            }
+        } else if ((local.ss_family == AF_INET) && ipv4) {
+            sockaddr_in* a4 = (sockaddr_in*)&a;
+            a4->sin_family = AF_INET;
+            a4->sin_port = htons(t.port);
+            a4->sin_addr.s_addr = htonl(t.address.toIPv4Address());
+        } else {
+            mBatch->otherTargets.append(i);
+            continue;
+        }
+        mBatch->addresses.append(a);
+        mBatch->msgTargets.append(i);
+    }
+
+    // Headers point into the address vector, which no longer changes
+    mBatch->msgs.resize(mBatch->addresses.count());
+    for (int m = 0; m < mBatch->msgs.count(); m++) {
+        mmsghdr& h = mBatch->msgs[m];
+        memset(&h, 0, sizeof(h));
+        h.msg_hdr.msg_name = &mBatch->addresses[m];
+        h.msg_hdr.msg_namelen = (local.ss_family == AF_INET6)
+                ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+        h.msg_hdr.msg_iov = &mBatch->iov;
+        h.msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/* Sends to targets from fromTarget onwards and returns the number of targets
+ * handled, which is all of them. Messages the kernel did not accept (e.g. the
+ * send buffer is full) are sent through Qt, which reports the error. */
+int GidUdp::sendBatch(const QByteArray& msg, int fromTarget)
+{
+    int fd = int(udpSocket.socketDescriptor());
+    if (!mBatch || (mBatch->fd != fd)) { buildBatch(fd); }
+
+    mBatch->iov.iov_base = const_cast<char*>(msg.constData());
+    mBatch->iov.iov_len = size_t(msg.size());
+
+    int first = 0;
+    while ((first < mBatch->msgTargets.count())
+           && (mBatch->msgTargets.at(first) < fromTarget)) {
+        first++;
+    }
+    int sent = first;
+    int n = mBatch->msgs.count();
+    while (sent < n) {
+        int r = sendmmsg(fd, mBatch->msgs.data() + sent, unsigned(n - sent), 0);
+        if (r <= 0) { break; }
+        sent += r;
+    }
+
+    for (int m = sent; m < n; m++) {
+        const Target& t = mTargets.at(mBatch->msgTargets.at(m));
+        sendMessage(msg, t.address, t.port);
+    }
+    foreach (int i, mBatch->otherTargets) {
+        if (i < fromTarget) { continue; }
+        sendMessage(msg, mTargets.at(i).address, mTargets.at(i).port);
+    }
+    return mTargets.count();
+}
+#endif
+
 void GidUdp::sendMessage(const QByteArray& msg, const QHostAddress& address, quint16 port)
 {
     udpSocket.writeDatagram(msg, address, port);
+    if (!mSocketOptionsApplied && (udpSocket.state() == QAbstractSocket::BoundState)) {
+        applySocketOptions();
+    }
 }
 
@@ -21,7 +21,11 @@
 #ifndef GIDUDP_H
 #define GIDUDP_H
 
+#include "gidsocketoptions.h"
+
+#include <QNetworkInterface>
 #include <QObject>
+#include <QScopedPointer>
 #include <QUdpSocket>
 
 class GidUdp : public QObject
@@ -29,12 +33,47 @@ class GidUdp : public QObject
     Q_OBJECT
 public:
     explicit GidUdp(QObject *parent = 0);
-    bool setupUdp(int port);
+    ~GidUdp();
+    /* If a multicast group is given, it is joined on the given interface, or
+     * on the default interface if the interface is invalid. */
+    bool setupUdp(int port, QHostAddress multicastGroup = QHostAddress(),
+                  QNetworkInterface multicastInterface = QNetworkInterface());
     void stopUdp();
 
+    struct Target {
+        QHostAddress address;
+        quint16 port;
+    };
+    /* Parses a comma-separated list of "address", "address:port" or
+     * "[IPv6 address]:port". Entries without a port get defaultPort. */
+    static bool parseTargets(QString text, quint16 defaultPort,
+                             QList<Target>* targets, QString* error);
+    // Targets are kept so they are not parsed and resolved for every send
+    void setSendTargets(QList<Target> targets);
+    /* Sends to all targets. On Linux, multiple targets are sent to with a
+     * single sendmmsg() call. */
+    void sendToTargets(const QByteArray& msg);
+
+    void setSocketOptions(GidSocketOptions options);
+    /* Datagrams the kernel dropped because the socket's receive buffer was
+     * full, read from /proc/net/udp and udp6 on Linux. -1 if not known. */
+    qint64 kernelDrops();
+
 private:
     QUdpSocket udpSocket;
     int udpPort;
+    GidSocketOptions mSocketOptions;
+    // The socket is bound by setupUdp() or implicitly by the first send
+    bool mSocketOptionsApplied = false;
+    void applySocketOptions();
+
+    QList<Target> mTargets;
+    // Socket addresses and message headers for sendmmsg(), built for the
+    // socket they were first used with
+    struct Batch;
+    QScopedPointer<Batch> mBatch;
+    void buildBatch(int fd);
+    int sendBatch(const QByteArray& msg, int fromTarget);
 
 private slots:
     void udpSocketReadyRead();
@@ -18,11 +18,13 @@
  *
  *****************************************************************************/
 
+#include "gidstartupprofile.h"
 #include "mainwindow.h"
 #include "version.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QTimer>
 
 #include <iostream>
 
@@ -43,6 +45,7 @@ void printVersion()
 
 int main(int argc, char *argv[])
 {
+    GidStartupProfile::start();
     printVersion();
 
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
@@ -50,6 +53,7 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
     QApplication::setApplicationName(APP_NAME);
     QApplication::setApplicationVersion(APP_VERSION);
+    GidStartupProfile::mark("Application created");
 
     // -------------------------------------------------------------------------
     // Set up command line options
@@ -102,6 +106,18 @@ int main(int argc, char *argv[])
     QCommandLineOption stopBitsOption("stopbits", stopBitsOptionText, "stopbits", "1");
     parser.addOption(stopBitsOption);
 
+    QMap<QString, QSerialPort::FlowControl> flowControls = {
+        {"none", QSerialPort::NoFlowControl},
+        {"rtscts", QSerialPort::HardwareControl},
+        {"xonxoff", QSerialPort::SoftwareControl}
+    };
+    QString flowControlOptionText =
+            QString("Serial port flow control option, one of: %1. Default: none")
+            .arg(flowControls.keys().join(", "));
+    QCommandLineOption flowControlOption("flowcontrol", flowControlOptionText,
+                                         "flowcontrol", "none");
+    parser.addOption(flowControlOption);
+
     QCommandLineOption sendFileOption(
                 "sendfile",
                 "Specify the path of a file which will be sent periodically.",
@@ -114,6 +130,11 @@ int main(int argc, char *argv[])
                 "sendfilefreq", "500");
     parser.addOption(sendFileFreqOption);
 
+    QCommandLineOption profileStartupOption(
+                "profile-startup",
+                "Print the time taken by each startup phase, up to the first data received.");
+    parser.addOption(profileStartupOption);
+
     // -------------------------------------------------------------------------
     // Process command line options
 
@@ -124,6 +145,9 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    GidStartupProfile::setEnabled(parser.isSet(profileStartupOption));
+    GidStartupProfile::mark("Command line parsed");
+
     MainWindow::StartupOptions mwOptions;
 
     mwOptions.sendFilePath = parser.value(sendFileOption.valueName());
@@ -177,11 +201,21 @@ int main(int argc, char *argv[])
         print("Invalid value for stop bits: " + stopBitsOptionValue + ", expected one of: " + stopBits.keys().join(", "));
     }
 
+    QString flowControlOptionValue = parser.value(flowControlOption.valueName());
+    if (flowControls.contains(flowControlOptionValue)) {
+        mwOptions.flowControl = flowControls.value(flowControlOptionValue);
+    } else {
+        print("Invalid value for flow control: " + flowControlOptionValue + ", expected one of: " + flowControls.keys().join(", "));
+    }
+
     // -------------------------------------------------------------------------
     // Run application
 
     MainWindow w(mwOptions);
+    GidStartupProfile::mark("Main window constructed");
     w.show();
+    GidStartupProfile::mark("Main window shown");
+    QTimer::singleShot(0, []() { GidStartupProfile::mark("Event loop running"); });
 
     return a.exec();
 }
@@ -26,7 +26,8 @@
 #include <QDesktopServices>
 #include <QFileDialog>
 #include <QMessageBox>
-#include <QTime>
+#include <QtConcurrent>
+#include <QtMath>
 
 
 MainWindow::MainWindow(StartupOptions options, QWidget *parent) :
@@ -35,10 +36,16 @@ MainWindow::MainWindow(StartupOptions options, QWidget *parent) :
     settings(QSettings::NativeFormat, QSettings::UserScope,
              "Noedigcode", "SimpleSerial")
 {
+    GidStartupProfile::mark("Settings read");
     ui->setupUi(this);
+    GidStartupProfile::mark("Main window UI built");
 
     ui->spinBox_maxProcessTimeMs->setValue(dataDisplay.allowedMs);
     ui->spinBox_displayBacklogLengthMs->setValue(dataDisplay.displayBacklogLengthMs);
+    ui->spinBox_guiRefreshRateHz->setValue(guiRefreshRateHz);
+    ui->spinBox_displaySpillMaxMb->setValue(dataDisplay.spillMaxBytes / (1024 * 1024));
+    ui->console->setFramePacing(true);
+    ui->widget_behind->setVisible(false);
 
     showStartupPage();
 
@@ -52,12 +59,30 @@ MainWindow::MainWindow(StartupOptions options, QWidget *parent) :
     ui->comboBox_send->installEventFilter(this);
     ui->console->installEventFilter(this);
 
+    setupFind();
+
     // Disable combo box auto-complete
     ui->comboBox_send->setCompleter(0);
 
+    connect(&metricsExporter, &GidMetricsExporter::print, this, [=](QString msg)
+    {
+        print("[metrics] " + msg, Qt::darkGray);
+    });
+    metricsTimer.start(500, this);
+
     loadGeneralSettings();
+    setupDisplayOptions();
+    setupFraming();
+    setupPlot();
+    connect(ui->tabWidget_tools, &QTabWidget::currentChanged, this, [=]()
+    {
+        setupToolTab(ui->tabWidget_tools->currentWidget());
+    });
+    GidStartupProfile::mark("Settings applied");
     setupSerial();
     setupNetwork();
+    setupReconnect();
+    GidStartupProfile::mark("Connections set up");
 
     updateWindowTitle();
 
@@ -71,8 +96,13 @@ MainWindow::MainWindow(StartupOptions options, QWidget *parent) :
         serial.setParity(options.parity);
         serial.setDataBits(options.dataBits);
         serial.setStopBits(options.stopBits);
-        on_pushButton_startup_openSerialPort_clicked();
-        serial.open();
+        serial.setFlowControl(options.flowControl);
+        // The serial port dialog is only shown if the port can't be opened
+        if (serial.open()) {
+            GidStartupProfile::mark("Serial port opened");
+        } else {
+            on_pushButton_startup_openSerialPort_clicked();
+        }
     }
     if (!options.sendFilePath.isEmpty()) {
         print("Startup option: send file: " + options.sendFilePath);
@@ -94,6 +124,7 @@ MainWindow::~MainWindow()
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     serial.close();
+    settings.flush();
     event->accept();
 }
 
@@ -134,6 +165,24 @@ bool MainWindow::eventFilter(QObject* watched, QEvent* event)
             }
         }
 
+    } else if (watched == ui->lineEdit_find) {
+
+        if (event->type() == QEvent::KeyPress) {
+            QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+            if ( (keyEvent->key() == Qt::Key_Enter) ||
+                 (keyEvent->key() == Qt::Key_Return) ) {
+                if (keyEvent->modifiers() & Qt::ShiftModifier) {
+                    consoleSearch->findPrevious();
+                } else {
+                    consoleSearch->findNext();
+                }
+                ret = true;
+            } else if (keyEvent->key() == Qt::Key_Escape) {
+                closeFind();
+                ret = true;
+            }
+        }
+
     } else if (watched == ui->console) {
 
         if (event->type() == QEvent::KeyPress) {
@@ -153,6 +202,487 @@ bool MainWindow::eventFilter(QObject* watched, QEvent* event)
     return ret;
 }
 
+void MainWindow::setupFraming()
+{
+    initComboBoxSetting(settingFramingMode, ui->comboBox_framing_mode);
+    initLineEditSetting(settingFramingDelimiter, ui->lineEdit_framing_delimiter);
+    initCheckableSetting(settingFramingKeepDelimiter, ui->checkBox_framing_keepDelimiter);
+    initComboBoxSetting(settingFramingLengthSize, ui->comboBox_framing_lengthSize);
+    initCheckableSetting(settingFramingLengthBigEndian,
+                         ui->checkBox_framing_lengthBigEndian);
+    initSpinBox(settingFramingLengthOffset, ui->spinBox_framing_lengthOffset);
+    initCheckableSetting(settingFramingLengthIncludesHeader,
+                         ui->checkBox_framing_lengthIncludesHeader);
+    initSpinBox(settingFramingMaxFrameSize, ui->spinBox_framing_maxFrameSize);
+    initCheckableSetting(settingUdpDatagrams, ui->checkBox_udp_datagrams);
+    initSpinBox(settingUdpDisplayRateLimit, ui->spinBox_udp_displayRateLimit);
+    datagramLimiter.setRate(ui->spinBox_udp_displayRateLimit->value());
+    initComboBoxSetting(settingDecoder, ui->comboBox_decoder);
+    initCheckableSetting(settingDecoderShowRaw, ui->checkBox_decoder_showRaw);
+
+    // Any change starts a new framer. Incomplete frames are discarded.
+    connect(ui->comboBox_framing_mode,
+            QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::updateFramer);
+    connect(ui->lineEdit_framing_delimiter, &QLineEdit::editingFinished,
+            this, &MainWindow::updateFramer);
+    connect(ui->checkBox_framing_keepDelimiter, &QCheckBox::toggled,
+            this, &MainWindow::updateFramer);
+    connect(ui->comboBox_framing_lengthSize,
+            QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::updateFramer);
+    connect(ui->checkBox_framing_lengthBigEndian, &QCheckBox::toggled,
+            this, &MainWindow::updateFramer);
+    connect(ui->spinBox_framing_lengthOffset, &QSpinBox::editingFinished,
+            this, &MainWindow::updateFramer);
+    connect(ui->checkBox_framing_lengthIncludesHeader, &QCheckBox::toggled,
+            this, &MainWindow::updateFramer);
+    connect(ui->spinBox_framing_maxFrameSize, &QSpinBox::editingFinished,
+            this, &MainWindow::updateFramer);
+    connect(ui->comboBox_decoder,
+            QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::updateDecoder);
+
+    updateFramer();
+    updateDecoder();
+}
+
+void MainWindow::updateFramer()
+{
+    enum { FramingNone, FramingDelimiter, FramingLengthPrefix, FramingSlip,
+           FramingCobs };
+    int mode = ui->comboBox_framing_mode->currentIndex();
+
+    switch (mode) {
+    case FramingDelimiter:
+        framer.reset(new GidDelimiterFramer(
+                         replaceEscapeSequences(
+                             ui->lineEdit_framing_delimiter->text().toLocal8Bit()),
+                         ui->checkBox_framing_keepDelimiter->isChecked()));
+        break;
+    case FramingLengthPrefix:
+        framer.reset(new GidLengthPrefixFramer(
+                         ui->spinBox_framing_lengthOffset->value(),
+                         1 << ui->comboBox_framing_lengthSize->currentIndex(),
+                         ui->checkBox_framing_lengthBigEndian->isChecked(),
+                         ui->checkBox_framing_lengthIncludesHeader->isChecked()));
+        break;
+    case FramingSlip:
+        framer.reset(new GidSlipFramer());
+        break;
+    case FramingCobs:
+        framer.reset(new GidCobsFramer());
+        break;
+    default:
+        framer.reset();
+    }
+    if (framer) {
+        framer->setMaxFrameSize(ui->spinBox_framing_maxFrameSize->value());
+    }
+
+    bool delimiter = (mode == FramingDelimiter);
+    bool length = (mode == FramingLengthPrefix);
+    ui->lineEdit_framing_delimiter->setEnabled(delimiter);
+    ui->checkBox_framing_keepDelimiter->setEnabled(delimiter);
+    ui->comboBox_framing_lengthSize->setEnabled(length);
+    ui->checkBox_framing_lengthBigEndian->setEnabled(length);
+    ui->spinBox_framing_lengthOffset->setEnabled(length);
+    ui->checkBox_framing_lengthIncludesHeader->setEnabled(length);
+    ui->spinBox_framing_maxFrameSize->setEnabled(mode != FramingNone);
+}
+
+void MainWindow::updateDecoder()
+{
+    enum { DecoderNone, DecoderModbusRtu, DecoderNmea };
+    int mode = ui->comboBox_decoder->currentIndex();
+
+    decoderIdleTimer.stop();
+    switch (mode) {
+    case DecoderModbusRtu: {
+        // Character time from the serial port settings, including the start,
+        // parity and stop bits.
+        int bitsPerChar = qCeil(serial.bitsPerCharacter());
+        decoder.reset(new GidModbusRtuDecoder(serial.s.baudRate(), bitsPerChar));
+        break;
+    }
+    case DecoderNmea:
+        decoder.reset(new GidNmeaDecoder());
+        break;
+    default:
+        decoder.reset();
+    }
+
+    ui->checkBox_decoder_showRaw->setEnabled(mode != DecoderNone);
+    ui->console_decoded->setVisible(mode != DecoderNone);
+}
+
+void MainWindow::onDecoderIdleTimer()
+{
+    if (!decoder || (decoder->pendingBytes() == 0)) {
+        decoderIdleTimer.stop();
+        return;
+    }
+    QList<GidProtocolDecoder::Message> messages;
+    decoder->idle(GidTimestamp::now(), messages);
+    showDecodedMessages(messages);
+}
+
+/* Decoded messages go through the display processor so they follow the data
+ * queued before them. In hex dump mode, they are shown below the hex dump. */
+void MainWindow::showDecodedMessages(const QList<GidProtocolDecoder::Message>& messages)
+{
+    foreach (const GidProtocolDecoder::Message& m, messages) {
+        numDecodedMessages->add();
+        if (!m.checksumOk) { numChecksumErrors->add(); }
+
+        if (!isHexDumpMode()) {
+            dataDisplay.processDecoded(decoder->name(), m);
+            continue;
+        }
+        QString t;
+        if (displayOptions.timestamps) {
+            timestampFormatter.appendTo(t, m.timestamp);
+            t += ": ";
+        }
+        t += QString("[%1] %2").arg(decoder->name()).arg(m.text);
+        if (!m.checksumOk) { t += " <checksum error>"; }
+        t += "\n";
+        ui->console_decoded->addText(t, m.checksumOk ? Qt::darkMagenta : Qt::red);
+        if (logAsDisplayed) { log(t.toLocal8Bit()); }
+    }
+}
+
+/* A datagram is a frame of its own, so it is not passed through the framer.
+ * Before the first datagram let through after some were suppressed, the
+ * number suppressed is shown. */
+void MainWindow::displayDatagram(const GidChunk& chunk)
+{
+    if (!datagramLimiter.allow(chunk.tag, chunk.data.count(),
+                               chunk.timestamp.monotonicUs())) {
+        return;
+    }
+    GidDatagramLimiter::Summary summary;
+    if (datagramLimiter.takeSummary(chunk.tag, &summary)) {
+        showDatagramSummary(summary);
+    }
+    numFramesRx->add();
+    frameSizeRx->record(chunk.data.count());
+    displayData(chunk, DataReceive);
+}
+
+void MainWindow::showDatagramSummary(const GidDatagramLimiter::Summary& summary)
+{
+    QString t;
+    if (!ui->console->cursorIsOnNewLine()) { t += "\n"; }
+    t += QString("... %1 datagrams (%2) from %3 suppressed\n")
+            .arg(summary.datagrams)
+            .arg(Utilities::bytesToString(summary.bytes))
+            .arg(summary.sender);
+    addTextToConsoleAndLogIfEnabled(t, Qt::darkGray);
+    dataDisplay.startNewLine();
+}
+
+void MainWindow::setupPlot()
+{
+    initCheckableSetting(settingPlotEnable, ui->checkBox_plot_enable);
+    initLineEditSetting(settingPlotPattern, ui->lineEdit_plot_pattern);
+    initSpinBox(settingPlotWindowSeconds, ui->spinBox_plot_windowSeconds);
+    initCheckableSetting(settingDisplayReceivedData, ui->checkBox_displayReceivedData);
+
+    connect(ui->lineEdit_plot_pattern, &QLineEdit::editingFinished,
+            this, &MainWindow::updatePlotPattern);
+
+    ui->plot->setTimeWindowSeconds(ui->spinBox_plot_windowSeconds->value());
+    updatePlotPattern();
+}
+
+void MainWindow::updatePlotPattern()
+{
+    plotExtractor.reset();
+    if (!plotExtractor.setPattern(ui->lineEdit_plot_pattern->text())) {
+        print("[plot] Invalid pattern: " + plotExtractor.errorString(), Qt::red);
+    }
+}
+
+void MainWindow::on_pushButton_plot_clear_clicked()
+{
+    ui->plot->clear();
+}
+
+void MainWindow::on_spinBox_plot_windowSeconds_valueChanged(int value)
+{
+    ui->plot->setTimeWindowSeconds(value);
+}
+
+void MainWindow::setupToolTab(QWidget* tab)
+{
+    if (toolTabsSetUp.contains(tab)) { return; }
+    toolTabsSetUp.insert(tab);
+
+    if (tab == ui->tab_latency) {
+        setupLatency();
+    } else if (tab == ui->tab_patternTest) {
+        setupPatternTest();
+    }
+}
+
+void MainWindow::setupLatency()
+{
+    initLineEditSetting(settingLatencyRequest, ui->lineEdit_latency_request);
+    initLineEditSetting(settingLatencyResponse, ui->lineEdit_latency_response);
+    initSpinBox(settingLatencyIntervalMs, ui->spinBox_latency_intervalMs);
+    initSpinBox(settingLatencyTimeoutMs, ui->spinBox_latency_timeoutMs);
+}
+
+void MainWindow::on_pushButton_latency_start_toggled(bool checked)
+{
+    if (!checked) {
+        latencySending = false;
+        if (!latencyProbe.pendingCount()) { latencyTimer.stop(); }
+        ui->pushButton_latency_start->setText("Start");
+        return;
+    }
+
+    if (!latencyProbe.setResponsePattern(ui->lineEdit_latency_response->text())) {
+        print("[latency] Invalid response pattern: " + latencyProbe.errorString(),
+              Qt::red);
+        ui->pushButton_latency_start->setChecked(false);
+        return;
+    }
+    latencyProbe.setRequest(ui->lineEdit_latency_request->text());
+    latencyProbe.setTimeoutMs(ui->spinBox_latency_timeoutMs->value());
+
+    latencySending = true;
+    latencyTimer.start(ui->spinBox_latency_intervalMs->value(), Qt::PreciseTimer, this);
+    ui->pushButton_latency_start->setText("Stop");
+}
+
+void MainWindow::on_spinBox_latency_intervalMs_valueChanged(int value)
+{
+    if (latencyTimer.isActive()) {
+        latencyTimer.start(value, Qt::PreciseTimer, this);
+    }
+}
+
+void MainWindow::onLatencyTimer()
+{
+    GidTimestamp now = GidTimestamp::now();
+    latencyProbe.expire(now);
+    latencyStatsDirty = true;
+
+    if (!latencySending) {
+        if (!latencyProbe.pendingCount()) { latencyTimer.stop(); }
+        return;
+    }
+    // Requests that can't be sent would be counted as lost
+    if (!canTransmit()) { return; }
+    // Escape sequences are replaced after the sequence number so it can be
+    // included in a checksum.
+    sendData(replaceEscapeSequences(latencyProbe.nextRequest(now)), false);
+}
+
+void MainWindow::updateLatencyStats()
+{
+    const GidLatencyHistogram& h = latencyProbe.histogram();
+
+    ui->label_latencyStats->setText(
+                QString("%1 sent, %2 received, %3 lost, %4 unmatched\n"
+                        "p50 %5, p90 %6, p99 %7, max %8, mean %9")
+                .arg(latencyProbe.sent())
+                .arg(h.count())
+                .arg(latencyProbe.lost())
+                .arg(latencyProbe.unmatched())
+                .arg(Utilities::usToString(h.percentile(50)))
+                .arg(Utilities::usToString(h.percentile(90)))
+                .arg(Utilities::usToString(h.percentile(99)))
+                .arg(Utilities::usToString(h.max()))
+                .arg(Utilities::usToString(h.mean())));
+
+    // One row per power of two from 64 us, with a bar relative to the
+    // fullest row.
+    const int bitsFrom = 6;
+    const int barWidth = 50;
+    QVector<qint64> counts = h.octaveCounts(bitsFrom);
+    qint64 fullest = 1;
+    foreach (qint64 n, counts) { fullest = qMax(fullest, n); }
+    QString text;
+    for (int i = 0; i < counts.count(); i++) {
+        QString from = (i == 0) ? QString("0")
+                                : Utilities::usToString(qint64(1) << (bitsFrom + i));
+        QString to = Utilities::usToString(qint64(1) << (bitsFrom + i + 1));
+        text += QString("%1 - %2 %3 %4\n")
+                .arg(from, 10).arg(to, -10).arg(counts.at(i), 8)
+                .arg(QString(int(counts.at(i) * barWidth / fullest), '#'));
+    }
+    ui->plainTextEdit_latency_histogram->setPlainText(text);
+}
+
+void MainWindow::on_pushButton_latency_clear_clicked()
+{
+    latencyProbe.clear();
+    updateLatencyStats();
+}
+
+void MainWindow::on_pushButton_latency_export_clicked()
+{
+    QString path = QFileDialog::getSaveFileName(
+                this,
+                "Export latency samples",
+                QFileInfo(ui->lineEdit_log_path->text()).path(),
+                "CSV files (*.csv)");
+
+    if (path.isEmpty()) { return; }
+
+    QString error;
+    if (latencyProbe.exportCsv(path, &error)) {
+        print(QString("[latency] Exported %1 samples to %2")
+              .arg(latencyProbe.samples().count()).arg(path), Qt::darkGray);
+    } else {
+        print("[latency] Export failed: " + error, Qt::red);
+    }
+}
+
+void MainWindow::setupPatternTest()
+{
+    initComboBoxSetting(settingPatternTestPattern, ui->comboBox_patternTest_pattern);
+    initSpinBox(settingPatternTestSeed, ui->spinBox_patternTest_seed);
+    initCheckableSetting(settingPatternTestVerify, ui->checkBox_patternTest_verify);
+}
+
+void MainWindow::on_pushButton_patternTest_start_toggled(bool checked)
+{
+    if (checked && (mCommsMode == CommsNone)) {
+        print("[pattern] No connection to test.", Qt::red);
+        ui->pushButton_patternTest_start->setChecked(false);
+        return;
+    }
+
+    ui->comboBox_patternTest_pattern->setEnabled(!checked);
+    ui->spinBox_patternTest_seed->setEnabled(!checked);
+    ui->checkBox_patternTest_verify->setEnabled(!checked);
+    ui->pushButton_patternTest_start->setText(checked ? "Stop" : "Start");
+
+    if (!checked) {
+        if (patternTestTimer.isActive()) {
+            patternTestSeconds = patternTestElapsed.elapsed() / 1000.0;
+            patternTestTimer.stop();
+        }
+        updatePatternTestStats();
+        return;
+    }
+
+    auto pattern = GidPatternGenerator::Pattern(
+                ui->comboBox_patternTest_pattern->currentIndex());
+    quint32 seed = ui->spinBox_patternTest_seed->value();
+    patternGenerator = GidPatternGenerator(pattern, seed);
+    if (ui->checkBox_patternTest_verify->isChecked()) {
+        patternVerifier.reset(new GidPatternVerifier(pattern, seed));
+    } else {
+        patternVerifier.reset();
+    }
+    patternTestBytesSent = 0;
+    patternTestBytesReceived = 0;
+    patternTestSeconds = 0;
+    patternTestElapsed.start();
+    patternTestTimer.start(1, Qt::PreciseTimer, this);
+    print(QString("[pattern] Test started with %1, seed %2.")
+          .arg(ui->comboBox_patternTest_pattern->currentText()).arg(seed),
+          Qt::darkGray);
+}
+
+void MainWindow::onPatternTestTimer()
+{
+    // Keep the write buffer of the connection filled up to a watermark, so
+    // data is sent as fast as the link accepts it without queueing more than
+    // necessary.
+    qint64 watermark = 65536;
+    int block = 4096;
+    int maxBlocks = 64;
+    if (mCommsMode == CommsSerial) {
+        // About 50 ms of data at the baud rate
+        watermark = qMax(64, serial.s.baudRate() / 10 / 20);
+        block = qMin(block, int(watermark));
+    } else if (mCommsMode == CommsUdp) {
+        // No write buffer to watch, so a few datagrams per tick
+        block = 1024;
+        maxBlocks = 8;
+    }
+
+    for (int i = 0; (i < maxBlocks) && (bytesToWrite() < watermark); i++) {
+        if (!transmit(patternGenerator.generate(block))) {
+            print("[pattern] Connection closed, test stopped.", Qt::red);
+            ui->pushButton_patternTest_start->setChecked(false);
+            return;
+        }
+        patternTestBytesSent += block;
+    }
+}
+
+void MainWindow::updatePatternTestStats()
+{
+    if (patternTestTimer.isActive()) {
+        patternTestSeconds = patternTestElapsed.elapsed() / 1000.0;
+    }
+    double seconds = qMax(patternTestSeconds, 0.001);
+
+    QString text = QString("Sent %1 (%2/s), received %3 (%4/s) in %5 s")
+            .arg(Utilities::bytesToString(patternTestBytesSent))
+            .arg(Utilities::bytesToString(patternTestBytesSent / seconds))
+            .arg(Utilities::bytesToString(patternTestBytesReceived))
+            .arg(Utilities::bytesToString(patternTestBytesReceived / seconds))
+            .arg(seconds, 0, 'f', 1);
+
+    if (!patternVerifier) {
+        text += "\nReceived data is not verified.";
+    } else if (!patternVerifier->isSynced()) {
+        text += QString("\nNot synchronised to the pattern (%1 bytes skipped).")
+                .arg(patternVerifier->stats().skippedBytes);
+    } else {
+        const GidPatternVerifier::Stats& st = patternVerifier->stats();
+        double bits = qMax(st.bytes, qint64(1)) * 8.0;
+        text += QString("\nVerified %1: %2 bit errors (BER %3) in %4 bytes, "
+                        "%5 bytes lost, %6 bytes duplicated")
+                .arg(Utilities::bytesToString(st.bytes))
+                .arg(st.bitErrors)
+                .arg(st.bitErrors / bits, 0, 'g', 3)
+                .arg(st.erroredBytes)
+                .arg(st.lostBytes)
+                .arg(st.duplicatedBytes);
+    }
+    ui->label_patternTestStats->setText(text);
+}
+
+void MainWindow::setupFind()
+{
+    consoleSearch = new GidConsoleSearch(ui->console, this);
+    connect(consoleSearch, &GidConsoleSearch::status,
+            ui->label_findStatus, &QLabel::setText);
+
+    connect(ui->lineEdit_find, &QLineEdit::textChanged,
+            this, &MainWindow::updateFindQuery);
+    connect(ui->comboBox_findMode,
+            QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::updateFindQuery);
+
+    ui->lineEdit_find->installEventFilter(this);
+    ui->widget_find->setVisible(false);
+}
+
+void MainWindow::updateFindQuery()
+{
+    // Combo box items are in the same order as GidConsoleSearch::Mode
+    GidConsoleSearch::Mode mode =
+            (GidConsoleSearch::Mode)ui->comboBox_findMode->currentIndex();
+    consoleSearch->setQuery(ui->lineEdit_find->text(), mode);
+}
+
+void MainWindow::closeFind()
+{
+    consoleSearch->cancel();
+    ui->widget_find->setVisible(false);
+    focusAndSelectSendText();
+}
+
 void MainWindow::focusAndSelectSendText()
 {
     // Set text box focus and select all text
@@ -163,6 +693,7 @@ void MainWindow::focusAndSelectSendText()
 void MainWindow::onAutoScrollChanged()
 {
     ui->console->autoScroll(ui->actionAuto_Scroll->isChecked());
+    ui->hexDump->setAutoScroll(ui->actionAuto_Scroll->isChecked());
 }
 
 void MainWindow::onToolsVisibilityChanged()
@@ -207,11 +738,35 @@ void MainWindow::initSpinBox(QString settingKey, QSpinBox* spinBox)
     });
 }
 
+void MainWindow::initComboBoxSetting(QString settingKey, QComboBox* comboBox)
+{
+    comboBox->setCurrentIndex(
+                settings.value(settingKey, comboBox->currentIndex()).toInt());
+    connect(comboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            [=](int index)
+    {
+        settings.setValue(settingKey, index);
+    });
+}
+
+/* Listing interfaces can take a while on some systems, so it is done in the
+ * background and printed when done. */
 void MainWindow::printNetworkAddresses()
+{
+    auto watcher = new QFutureWatcher<QList<QNetworkInterface>>(this);
+    connect(watcher, &QFutureWatcher<QList<QNetworkInterface>>::finished, this, [=]()
+    {
+        printNetworkAddresses(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(&QNetworkInterface::allInterfaces));
+}
+
+void MainWindow::printNetworkAddresses(QList<QNetworkInterface> interfaces)
 {
     QString text = "This computer's IP addresses:\n";
 
-    foreach (QNetworkInterface iface, QNetworkInterface::allInterfaces()) {
+    foreach (QNetworkInterface iface, interfaces) {
         text += QString("%1: ").arg(iface.name());
         QString addresses;
         foreach (QNetworkAddressEntry addr, iface.addressEntries()) {
@@ -231,190 +786,67 @@ void MainWindow::printNetworkAddresses()
 void MainWindow::print(QString msg, QColor c)
 {
     ui->console->addText(msg + "\n", c);
-}
-
-void MainWindow::addDataToConsole(QByteArray data, DataDirection dataDir)
-{
-    bool timestampEnabled = ui->checkBox_timestamps_enable->isChecked();
-    bool timestampAfterNewline = ui->checkBox_timestamps_after_newline->isChecked();
-    int timestampTimeLimitMs = ui->spinBox_timestamps_time_ms->text().toInt();
-
-    if (!lastTimestamp.isValid()) { lastTimestamp.start(); }
-
-    bool timestampTimeElapsed = (lastTimestamp.elapsed() > timestampTimeLimitMs);
-    if (timestampTimeElapsed) { lastTimestamp.start(); }
-
-    bool timestampShown = false;
-
-    for (int i=0; i < data.count(); i++) {
-
-        unsigned char c = data.at(i);
-        bool outputHex = false;
-        bool outputNormal = true;
-
-        bool printTimestamp = false;
-        if (timestampEnabled) {
-
-            if (dataDir == DataSend) {
-                // No newline or time grouping for sending
-                if (!timestampShown) {
-                    printTimestamp = true;
-                }
-            } else {
-                // When receiving data, extra timestamp options come into play
-                // Check if timestamp is only allowed after newline
-                if (timestampAfterNewline) {
-                    if (mLastRxDataAddedToConsoleWasNewline) {
-                        printTimestamp = true;
-                    } else {
-                        printTimestamp = false;
-                    }
-                } else {
-                    // Timestamp not limited by newline, so allow it if it hasn't
-                    // been shown yet in this cycle.
-                    if (!timestampShown) {
-                        printTimestamp = true;
-                    }
-                }
-
-                // Now check time threshold requirements for timestamp
-                if (printTimestamp && timestampTimeLimitMs) {
-                    if (!timestampTimeElapsed) {
-                        // New timestamp not allowed based on time threshold
-                        printTimestamp = false;
-                    }
-                }
-            }
-        }
-
-        // If showing send data, add a newline before it if set
-        if ((dataDir == DataSend)
-            && (!ui->console->cursorIsOnNewLine()) // Prevent unnecessary empty lines
-            && (i == 0))
-        {
-            if (ui->checkBox_showSentDataOnSeparateLine->isChecked()) {
-                addTextToConsoleAndLogIfEnabled("\n");
-            }
-        }
-
-        if (printTimestamp) {
-            QString t;
-            if (!ui->console->cursorIsOnNewLine()) {
-                t += "\n";
-            }
-            t += QString("%1: ")
-                    .arg(QTime::currentTime().toString("hh:mm:ss:zzz"));
-            addTextToConsoleAndLogIfEnabled(t, Qt::blue);
-            lastWasHex = false;
-            timestampShown = true;
-        }
-
-        if (ui->radioButton_displayMode_hex->isChecked()) {
-            // Hex mode.
-            // Hex mode trumps the rest. All characters are converted to hex.
-            // Newlines are treated as normal hex data.
-            outputHex = true;
-            outputNormal = false;
-        } else {
-            // ASCII text mode.
-            // Take special characters hex into account
-            bool special = ((c < 32) || (c == 127));
-            bool notCrLfTab = (c != '\t') && (c != '\n') && (c != '\r');
-            if (special && notCrLfTab) {
-                if (ui->checkBox_showHexForSpecialChars->isChecked()) {
-                    // Show special character in hex
-                    outputHex = true;
-                    outputNormal = false;
-                }
-            }
-        }
-
-        if (outputHex) {
-            QString hex = QString("%1").arg(c, 2, 16, QChar('0')).toUpper();;
-            bool virtuallyAtLineStart =    printTimestamp
-                                        || ui->console->cursorIsOnNewLine();
-            addNonBreakingTextToConsole(hex, QColor(Qt::red),
-                                        virtuallyAtLineStart, true);
-            lastWasHex = true;
-        }
-
-        // Normal text output
-        if (outputNormal) {
-
-            if (c == '\n') {
-                if (ui->checkBox_showCrLfHex->isChecked()) {
-                    if (lastWasHex) {
-                        addTextToConsoleAndLogIfEnabled(" ");
-                        lastWasHex = false;
-                    }
-                    addNonBreakingTextToConsole("<LF>", QColor(Qt::red));
-                }
-                if (!ui->checkBox_crLfNewline->isChecked()) {
-                    // Prevent outputting newline
-                    outputNormal = false;
-                }
-            } else if (c == '\r') {
-                outputNormal = false;
-                if (ui->checkBox_showCrLfHex->isChecked()) {
-                    if (lastWasHex) {
-                        addTextToConsoleAndLogIfEnabled(" ");
-                        lastWasHex = false;
-                    }
-                    addNonBreakingTextToConsole("<CR>", QColor(Qt::red));
-                }
-            }
-
-            if (outputNormal) {
-                if (lastWasHex) {
-                    addTextToConsoleAndLogIfEnabled(" ");
-                    lastWasHex = false;
-                }
-                addTextToConsoleAndLogIfEnabled(QString(c), QColor(Qt::black));
-            }
-        }
-
-        // Newline after showing send data
-        if ((dataDir == DataSend)
-            && (!ui->console->cursorIsOnNewLine()) // Prevent unnecessary empty lines
-            && (i == data.length()-1))
-        {
-            if (ui->checkBox_showSentDataOnSeparateLine->isChecked()) {
-                addTextToConsoleAndLogIfEnabled("\n");
-                lastWasHex = false;
-            }
-        }
-
-        mLastRxDataAddedToConsoleWasNewline = (c == '\n');
+    dataDisplay.startNewLine();
+    requestFrame();
+}
+
+void MainWindow::setupDisplayOptions()
+{
+    QList<QAbstractButton*> buttons {
+        ui->radioButton_displayMode_hex,
+        ui->checkBox_showHexForSpecialChars,
+        ui->checkBox_showCrLfHex,
+        ui->checkBox_crLfNewline,
+        ui->checkBox_showSentDataOnSeparateLine,
+        ui->checkBox_timestamps_enable,
+        ui->checkBox_timestamps_after_newline,
+        ui->radioButton_log_asDisplayed
+    };
+    foreach (QAbstractButton* button, buttons) {
+        connect(button, &QAbstractButton::toggled,
+                this, &MainWindow::updateDisplayOptions);
     }
-}
-
-void MainWindow::addNonBreakingTextToConsole(QString text, QColor color,
-                                             bool virtuallyAtLineStart,
-                                             bool addSpaceBefore)
-{
-    bool addedNewline = false;
-    int lenToAdd = text.length();
-    if (addSpaceBefore) { lenToAdd += 1; }
-    if (ui->console->remainingOnLine() < lenToAdd) {
-        text.prepend("\n");
-        addedNewline = true;
+    connect(ui->spinBox_timestamps_time_ms, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MainWindow::updateDisplayOptions);
+    // Lines are wrapped by the formatter
+    connect(ui->console, &GidConsoleWidget::lineCharsChanged,
+            this, &MainWindow::updateDisplayOptions);
+
+    updateDisplayOptions();
+}
+
+void MainWindow::updateDisplayOptions()
+{
+    GidConsoleFormatter::Options o;
+    o.hex = ui->radioButton_displayMode_hex->isChecked();
+    o.hexForSpecialChars = ui->checkBox_showHexForSpecialChars->isChecked();
+    o.showCrLfHex = ui->checkBox_showCrLfHex->isChecked();
+    o.crLfNewline = ui->checkBox_crLfNewline->isChecked();
+    o.sentDataOnSeparateLine = ui->checkBox_showSentDataOnSeparateLine->isChecked();
+    o.timestamps = ui->checkBox_timestamps_enable->isChecked();
+    o.timestampsAfterNewline = ui->checkBox_timestamps_after_newline->isChecked();
+    o.timestampTimeLimitMs = ui->spinBox_timestamps_time_ms->value();
+    o.lineChars = ui->console->lineChars();
+    o.tabChars = ui->console->tabChars();
+    displayOptions = o;
+    logAsDisplayed = ui->radioButton_log_asDisplayed->isChecked();
+}
+
+void MainWindow::addFormattedToConsole(const QList<GidConsoleFormatter::Segment>& segments)
+{
+    foreach (const GidConsoleFormatter::Segment& segment, segments) {
+        ui->console->addWrappedText(segment.text, segment.color);
+        // The log file is not wrapped at the console width
+        if (logAsDisplayed) { log(segment.unwrapped().toLocal8Bit()); }
     }
-
-    // Add space before if set, but only if we are not at the start of a line
-    if (addSpaceBefore) {
-        bool atStartOfLine = virtuallyAtLineStart || addedNewline;
-        if (!atStartOfLine) {
-            text.prepend(" ");
-        }
-    }
-
-    addTextToConsoleAndLogIfEnabled(text, color);
+    requestFrame();
 }
 
 void MainWindow::addTextToConsoleAndLogIfEnabled(QString text, QColor color)
 {
     ui->console->addText(text, color);
-    if (ui->radioButton_log_asDisplayed->isChecked()) {
+    requestFrame();
+    if (logAsDisplayed) {
         log(text.toLocal8Bit());
     }
 }
@@ -437,13 +869,49 @@ void MainWindow::setCommsModeAndUpdateGui(CommsMode mode)
     ui->action_Disconnect_from_TCP_Server->setVisible(tcpClient);
 }
 
-void MainWindow::onDataReceived(QByteArray data)
+void MainWindow::onDataReceived(GidChunk chunk)
 {
-    dataDisplay.processData(data, DataReceive);
+    if (!firstDataReceived) {
+        firstDataReceived = true;
+        GidStartupProfile::mark("First data received");
+    }
+
+    const QByteArray& data = chunk.data;
+
+    // During a pattern test, received data only goes to the verifier. It is
+    // not displayed, decoded, logged or replied to.
+    if (patternTestTimer.isActive()) {
+        patternTestBytesReceived += data.count();
+        if (patternVerifier) { patternVerifier->feed(data); }
+        countReceived(data.count());
+        return;
+    }
+
+    if (ui->checkBox_plot_enable->isChecked()) {
+        plotExtractor.feed(chunk, ui->plot);
+    }
+    if (latencyTimer.isActive() || latencyProbe.pendingCount()) {
+        int n = latencyProbe.feed(chunk);
+        if (n) { latencyStatsDirty = true; }
+    }
+
+    // Data is displayed before it is decoded so decoded messages follow it
+    if (ui->checkBox_displayReceivedData->isChecked()
+            && (!decoder || ui->checkBox_decoder_showRaw->isChecked())) {
+        displayReceived(chunk);
+    }
+    if (decoder) {
+        QList<GidProtocolDecoder::Message> messages;
+        decoder->feed(chunk, messages);
+        showDecodedMessages(messages);
+        if (decoder->usesIdle() && decoder->pendingBytes()
+                && !decoderIdleTimer.isActive()) {
+            decoderIdleTimer.start(5, Qt::PreciseTimer, this);
+        }
+    }
 
     // Display number of received bytes
-    numBytesRx += data.count();
-    updateCounterLabels();
+    countReceived(data.count());
 
     // Log raw data if enabled
     if (ui->radioButton_log_raw->isChecked()) {
@@ -473,73 +941,26 @@ void MainWindow::sendData(QByteArray data, bool allowEscapeSequenceReplace)
 {
     if (allowEscapeSequenceReplace) {
         if (ui->checkBox_sending_replaceEscapeSequences->isChecked()) {
-            // Hex
-            static QByteArray hex("0123456789abcdef");
-            QByteArray tosend;
-            QByteArray lowerData = data.toLower();
-            QByteArray buffer; // Collect bytes to be converted to hex
-            int state = 0;
-            for (int i = 0; i < data.count(); i++) {
-                char c = data.at(i);
-                char clower = lowerData.at(i);
-                bool addChar = false; // Add current char to send data
-                bool addBuffer = false; // Add collected bytes to send data
-
-                if (state == 0) {
-                    // Wait for start of escape sequence.
-                    buffer.clear();
-                    if (c == '\\') {
-                        // Start of escape sequence
-                        state = 1;
-                    } else {
-                        // Not start of escape sequence. Send char.
-                        addChar = true;
-                    }
-                } else if (state == 1) {
-                    if (hex.contains(clower)) {
-                        // Hex character. Collect in buffer.
-                        buffer.append(c);
-                        state = 2;
-                    } else {
-                        // Cancel escape sequence. Also send collected buffer chars.
-                        addChar = true;
-                        addBuffer = true;
-                        state = 0;
-                    }
-                } else if (state == 2) {
-                    if (hex.contains(clower)) {
-                        // Hex character. Collect in buffer, convert to hex and send.
-                        buffer.append(c);
-                        tosend.append(buffer.toShort(nullptr, 16));
-                    } else {
-                        // Cancel escape sequence. Also send collected buffer chars.
-                        addChar = true;
-                        addBuffer = true;
-                    }
-                    // End of escape sequence. Reset to wait for next.
-                    state = 0;
-                }
-
-                if (addBuffer) {
-                    tosend.append("\\");
-                    tosend.append(buffer);
-                }
-                if (addChar) { tosend.append(c); }
-            }
-            data = tosend;
-            // Other escape sequences
-            data.replace(QByteArray("\\n"), QByteArray("\n"));
-            data.replace(QByteArray("\\r"), QByteArray("\r"));
-            data.replace(QByteArray("\\t"), QByteArray("\t"));
-            // NB: Do \0 after hex above so it doesn't interfere
-            data.replace(QByteArray("\\0"), QByteArray(1, '\0'));
-            data.replace(QByteArray("\\\\"), QByteArray("\\"));
+            data = replaceEscapeSequences(data);
         }
     }
 
+    if (!transmit(data)) { return; }
+
+    if (ui->checkBox_showSentDataInConsole->isChecked()) {
+        displayData({data, GidTimestamp::now()}, DataSend);
+    }
+
+    flushLog();
+}
+
+/* Sends data over the current connection and counts it, without displaying
+ * it. Returns false if there is no connection. */
+bool MainWindow::transmit(const QByteArray& data)
+{
     switch (mCommsMode) {
     case MainWindow::CommsNone:
-        return;
+        return false;
         break;
     case MainWindow::CommsSerial:
         sendSerial(data);
@@ -555,14 +976,129 @@ void MainWindow::sendData(QByteArray data, bool allowEscapeSequenceReplace)
         break;
     }
 
-    numBytesTx += data.count();
-    updateCounterLabels();
+    numBytesTx->add(data.count());
+    numChunksTx->add();
+    chunkSizeTx->record(data.count());
+    counterLabelsDirty = true;
+    requestFrame();
+    return true;
+}
+
+// Whether the current connection is open for sending
+bool MainWindow::canTransmit()
+{
+    switch (mCommsMode) {
+    case MainWindow::CommsSerial:
+        return serial.s.isOpen();
+    case MainWindow::CommsTcpServer:
+        return tcp.serverConnectionCount() > 0;
+    case MainWindow::CommsTcpClient:
+        return tcp.isConnectedToServer();
+    case MainWindow::CommsUdp:
+        return udpTargetsError.isEmpty();
+    default:
+        return false;
+    }
+}
+
+/* Bytes written to the current connection but not yet sent. Always zero for
+ * UDP. */
+qint64 MainWindow::bytesToWrite()
+{
+    switch (mCommsMode) {
+    case MainWindow::CommsSerial:
+        return serial.s.bytesToWrite();
+    case MainWindow::CommsTcpServer:
+    case MainWindow::CommsTcpClient:
+        return tcp.bytesToWrite();
+    default:
+        return 0;
+    }
+}
+
+QByteArray MainWindow::replaceEscapeSequences(QByteArray data)
+{
+    return messageCompiler.compile(data);
+}
+
+void MainWindow::setupReconnect()
+{
+    initCheckableSetting(settingAutoReconnect, ui->checkBox_autoReconnect);
+    initSpinBox(settingReconnectMaxDelayS, ui->spinBox_reconnectMaxDelayS);
+    reconnectSupervisor.setEnabled(ui->checkBox_autoReconnect->isChecked());
+    reconnectSupervisor.setMaxDelayMs(ui->spinBox_reconnectMaxDelayS->value() * 1000);
+
+    connect(ui->checkBox_autoReconnect, &QCheckBox::toggled, this, [=](bool checked)
+    {
+        reconnectSupervisor.setEnabled(checked);
+    });
+    connect(ui->spinBox_reconnectMaxDelayS, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [=](int value)
+    {
+        reconnectSupervisor.setMaxDelayMs(value * 1000);
+    });
+
+    connect(&reconnectSupervisor, &GidReconnectSupervisor::attempt,
+            this, &MainWindow::onReconnectAttempt);
+    connect(&reconnectSupervisor, &GidReconnectSupervisor::reconnected,
+            this, [=](qint64 downtimeUs)
+    {
+        numReconnects->add();
+        reconnectDowntimeUs->add(downtimeUs);
+        print("[reconnect] Reconnected after " + Utilities::usToString(downtimeUs),
+              Qt::darkGray);
+    });
+
+    // Don't wait for the next attempt when the serial device reappears
+    connect(serial.portWatcher(), &GidSerialPortWatcher::portAdded,
+            this, [=](QString portName)
+    {
+        if ((mCommsMode != CommsSerial) || !reconnectSupervisor.isDown()) { return; }
+        QString current = serial.s.portName();
+        if (current.startsWith("/dev/")) { current.remove(0, 5); }
+        if (portName == current) { reconnectSupervisor.retryNow(); }
+    });
+}
+
+void MainWindow::reconnectLater()
+{
+    if (!reconnectSupervisor.isEnabled()) { return; }
+    reconnectSupervisor.connectionLost();
+    print(QString("[reconnect] Attempt %1 in %2")
+          .arg(reconnectSupervisor.attemptCount() + 1)
+          .arg(Utilities::usToString(qint64(reconnectSupervisor.nextDelayMs()) * 1000)),
+          Qt::darkGray);
+}
+
+/* A serial port is opened synchronously. A TCP connection attempt reports
+ * its outcome later with the client connected or error signals. */
+void MainWindow::onReconnectAttempt()
+{
+    switch (mCommsMode) {
+    case CommsSerial:
+        if (!serial.reOpen()) { reconnectLater(); }
+        break;
+    case CommsTcpClient:
+        tcp.connectToServer(mTcpClientAddress, mTcpClientPort);
+        break;
+    default:
+        reconnectSupervisor.stop();
+    }
+}
+
+void MainWindow::updateReconnectStats()
+{
+    connectionDown->set(reconnectSupervisor.isDown() ? 1 : 0);
 
-    if (ui->checkBox_showSentDataInConsole->isChecked()) {
-        dataDisplay.processData(data, DataSend);
+    QString text = QString("%1, total downtime %2")
+            .arg(reconnectSupervisor.reconnectCount())
+            .arg(Utilities::usToString(reconnectSupervisor.downtimeUs()));
+    if (reconnectSupervisor.isDown()) {
+        text += QString(" (down for %1, attempt %2)")
+                .arg(Utilities::usToString(reconnectSupervisor.currentDowntimeUs()))
+                .arg(reconnectSupervisor.attemptCount() + 1);
     }
-
-    flushLog();
+    ui->label_reconnectStats->setText(text);
 }
 
 void MainWindow::setupSerial()
@@ -597,6 +1133,7 @@ void MainWindow::sendSerial(QByteArray data)
 
 void MainWindow::closeSerialPort()
 {
+    reconnectSupervisor.stop();
     if (serial.s.isOpen()) {
         serial.s.close();
         printSerial("Serial port closed.");
@@ -604,12 +1141,49 @@ void MainWindow::closeSerialPort()
     }
 }
 
+void MainWindow::countReceived(int bytes)
+{
+    numBytesRx->add(bytes);
+    numChunksRx->add();
+    chunkSizeRx->record(bytes);
+    counterLabelsDirty = true;
+    requestFrame();
+}
+
+void MainWindow::requestFrame()
+{
+    if (!presentationTimer.isActive()) {
+        presentationTimer.start(1000 / guiRefreshRateHz, this);
+    }
+}
+
+void MainWindow::onPresentationTimer()
+{
+    bool dirty = counterLabelsDirty || displayProcessorLabelsDirty;
+
+    if (counterLabelsDirty) {
+        counterLabelsDirty = false;
+        updateCounterLabels();
+    }
+    if (displayProcessorLabelsDirty) {
+        displayProcessorLabelsDirty = false;
+        dataDisplay.updateGuiInfo();
+    }
+    ui->console->presentFrame();
+    ui->hexDump->presentFrame();
+    ui->plot->presentFrame();
+
+    // Stop refreshing when idle. The next change will request a new frame.
+    if (!dirty) { presentationTimer.stop(); }
+}
+
 void MainWindow::updateCounterLabels()
 {
-    ui->label_bytesRx->setText(QString::number(numBytesRx));
-    ui->label_bytesTx->setText(QString::number(numBytesTx));
+    ui->label_bytesRx->setText(QString::number(numBytesRx->value()));
+    ui->label_bytesTx->setText(QString::number(numBytesTx->value()));
 
-    ui->label_bytesDropped->setText(QString("%1").arg(numBytesDroppedFromDisplay));
+    ui->label_bytesDropped->setText(
+                QString("%1").arg(numBytesDroppedFromDisplay->value()));
 }
 
 void MainWindow::sendMacro(QString text)
@@ -620,7 +1194,26 @@ void MainWindow::sendMacro(QString text)
 
 void MainWindow::onSerialReadyRead()
 {
-    onDataReceived(serial.s.readAll());
+    int window = serial.coalesceMs();
+    if (window > 0) {
+        // Timing based decoders (Modbus RTU) take the timestamp as the end
+        // of the chunk
+        serialCoalesceTimestamp = GidTimestamp::now();
+        if (!serialCoalesceTimer.isActive()) {
+            serialCoalesceTimer.start(window, Qt::PreciseTimer, this);
+        }
+        return;
+    }
+    onDataReceived({serial.s.readAll(), GidTimestamp::now()});
+}
+
+void MainWindow::onSerialCoalesceTimer()
+{
+    serialCoalesceTimer.stop();
+    if (!serial.s.isOpen()) { return; }
+    QByteArray data = serial.s.readAll();
+    if (data.isEmpty()) { return; }
+    onDataReceived({data, serialCoalesceTimestamp});
 }
 
 void MainWindow::onSerialError(QSerialPort::SerialPortError error)
@@ -628,13 +1221,26 @@ void MainWindow::onSerialError(QSerialPort::SerialPortError error)
     if (error == QSerialPort::NoError) { return; }
     QString s = QVariant::fromValue(error).toString();
     printSerial("Serial port error: " + s);
+
+    // The device was removed or reset
+    if ((error == QSerialPort::ResourceError) && serial.s.isOpen()) {
+        serialCoalesceTimer.stop();
+        serial.s.close();
+        printSerial("Serial port closed.");
+        updateWindowTitle();
+        reconnectLater();
+    }
 }
 
 void MainWindow::onSerialPortOpened()
 {
+    reconnectSupervisor.connected();
     setCommsModeAndUpdateGui(CommsSerial);
     updateWindowTitle();
 
+    // Modbus RTU timing depends on the port settings
+    updateDecoder();
+
     focusAndSelectSendText();
 
     // Save settings
@@ -663,6 +1269,36 @@ void MainWindow::setupNetwork()
     // UDP
     connect(&udp, &GidUdp::print, this, &MainWindow::printUdp);
     connect(&udp, &GidUdp::rxMessage, this, &MainWindow::onUdpDataReceived);
+
+    // Socket options
+    initCheckableSetting(settingSocketNoDelay, ui->checkBox_socket_noDelay);
+    initCheckableSetting(settingSocketKeepAlive, ui->checkBox_socket_keepAlive);
+    initSpinBox(settingSocketReceiveBufferKb, ui->spinBox_socket_receiveBufferKb);
+    initSpinBox(settingSocketSendBufferKb, ui->spinBox_socket_sendBufferKb);
+    initSpinBox(settingSocketTypeOfService, ui->spinBox_socket_typeOfService);
+    updateSocketOptions();
+    connect(ui->checkBox_socket_noDelay, &QCheckBox::toggled,
+            this, &MainWindow::updateSocketOptions);
+    connect(ui->checkBox_socket_keepAlive, &QCheckBox::toggled,
+            this, &MainWindow::updateSocketOptions);
+    connect(ui->spinBox_socket_receiveBufferKb, &QSpinBox::editingFinished,
+            this, &MainWindow::updateSocketOptions);
+    connect(ui->spinBox_socket_sendBufferKb, &QSpinBox::editingFinished,
+            this, &MainWindow::updateSocketOptions);
+    connect(ui->spinBox_socket_typeOfService, &QSpinBox::editingFinished,
+            this, &MainWindow::updateSocketOptions);
+}
+
+void MainWindow::updateSocketOptions()
+{
+    GidSocketOptions options;
+    options.noDelay = ui->checkBox_socket_noDelay->isChecked();
+    options.keepAlive = ui->checkBox_socket_keepAlive->isChecked();
+    options.receiveBufferSize = ui->spinBox_socket_receiveBufferKb->value() * 1024;
+    options.sendBufferSize = ui->spinBox_socket_sendBufferKb->value() * 1024;
+    options.typeOfService = ui->spinBox_socket_typeOfService->value();
+    tcp.setSocketOptions(options);
+    udp.setSocketOptions(options);
 }
 
 void MainWindow::sendTcpServer(QByteArray data)
@@ -686,6 +1322,7 @@ void MainWindow::stopTcpServer()
 
 void MainWindow::disconnectFromTcpServer()
 {
+    reconnectSupervisor.stop();
     tcp.disconnectFromServer();
 }
 
@@ -696,12 +1333,13 @@ void MainWindow::printTcp(QString msg)
 
 void MainWindow::onTcpDataReceived(GidTcp::ConPtr /*con*/, QByteArray data)
 {
-    onDataReceived(data);
+    onDataReceived({data, GidTimestamp::now()});
 }
 
 void MainWindow::onTcpClientConnectedToServer()
 {
     printTcp("Connected to TCP server.");
+    reconnectSupervisor.connected();
     updateWindowTitle();
 }
 
@@ -709,29 +1347,58 @@ void MainWindow::onTcpClientError(QString errorString)
 {
     printTcp("TCP client error: " + errorString);
     updateWindowTitle();
+
+    // The connection attempt failed. Lost connections are handled when
+    // disconnected.
+    if ((mCommsMode == CommsTcpClient)
+            && (tcp.clientState() == QAbstractSocket::UnconnectedState)) {
+        reconnectLater();
+    }
 }
 
 void MainWindow::onTcpClientDisconnected()
 {
     printTcp("Disconnected from TCP server.");
     updateWindowTitle();
+
+    if (mCommsMode == CommsTcpClient) { reconnectLater(); }
 }
 
 void MainWindow::sendUdp(QByteArray data)
 {
-    QHostAddress a;
-    if (mUdpSendBroadcast) {
-        a = QHostAddress::Broadcast;
-    } else {
-        a = QHostAddress(mUdpSendIp);
+    if (!udpTargetsError.isEmpty()) {
+        printUdp("Not sent: " + udpTargetsError);
+        return;
+    }
+    udp.sendToTargets(data);
+}
+
+void MainWindow::updateMulticastInterfaces()
+{
+    QString selected = ui->comboBox_udp_multicastInterface->currentData().toString();
+    if (selected.isEmpty()) {
+        selected = settings.value(settingUdpMulticastInterface).toString();
     }
 
-    udp.sendMessage(data, a, mUdpSendPort);
+    ui->comboBox_udp_multicastInterface->clear();
+    ui->comboBox_udp_multicastInterface->addItem("Default", QString());
+    foreach (QNetworkInterface iface, QNetworkInterface::allInterfaces()) {
+        QNetworkInterface::InterfaceFlags flags = iface.flags();
+        if (!(flags & QNetworkInterface::IsUp) || !(flags & QNetworkInterface::CanMulticast)) {
+            continue;
+        }
+        ui->comboBox_udp_multicastInterface->addItem(iface.humanReadableName(),
+                                                     iface.name());
+    }
+    int index = ui->comboBox_udp_multicastInterface->findData(selected);
+    ui->comboBox_udp_multicastInterface->setCurrentIndex(qMax(0, index));
 }
 
 void MainWindow::stopUdp()
 {
     udp.stopUdp();
+    udpKernelDropsReported = 0;
+    datagramLimiter.clear();
     updateWindowTitle();
 }
 
@@ -740,10 +1407,17 @@ void MainWindow::printUdp(QString msg)
     print("[udp] " + msg, Qt::darkGray);
 }
 
-void MainWindow::onUdpDataReceived(QByteArray msg, QHostAddress /*address*/,
-                                   quint16 /*port*/)
+void MainWindow::onUdpDataReceived(QByteArray msg, QHostAddress address,
+                                   quint16 port)
 {
-    onDataReceived(msg);
+    GidChunk chunk(msg, GidTimestamp::now());
+    if (ui->checkBox_udp_datagrams->isChecked()) {
+        QString ip = GidTcp::ipString(address);
+        if (ip.contains(':')) { ip = "[" + ip + "]"; }
+        chunk.frameStart = true;
+        chunk.tag = ip + ":" + QString::number(port);
+    }
+    onDataReceived(chunk);
 }
 
 void MainWindow::log(QByteArray data)
@@ -762,6 +1436,7 @@ void MainWindow::log(QByteArray data)
 void MainWindow::flushLog()
 {
     if (logFile.isOpen()) {
+        logQueueBytes->set(logFile.bytesToWrite());
         logFile.flush();
     }
 }
@@ -826,6 +1501,18 @@ void MainWindow::timerEvent(QTimerEvent* ev)
         onTimedMsgTimer();
     } else if (ev->timerId() == sendFileTimer.timerId()) {
         onSendFileTimer();
+    } else if (ev->timerId() == metricsTimer.timerId()) {
+        onMetricsTimer();
+    } else if (ev->timerId() == presentationTimer.timerId()) {
+        onPresentationTimer();
+    } else if (ev->timerId() == decoderIdleTimer.timerId()) {
+        onDecoderIdleTimer();
+    } else if (ev->timerId() == latencyTimer.timerId()) {
+        onLatencyTimer();
+    } else if (ev->timerId() == patternTestTimer.timerId()) {
+        onPatternTestTimer();
+    } else if (ev->timerId() == serialCoalesceTimer.timerId()) {
+        onSerialCoalesceTimer();
     }
 }
 
@@ -838,11 +1525,15 @@ void MainWindow::on_checkBox_AutoReply_Enable_clicked()
 void MainWindow::on_actionScroll_to_Bottom_triggered()
 {
     ui->console->scrollToBottom();
+    ui->hexDump->scrollToBottom();
+    ui->console_decoded->scrollToBottom();
 }
 
 void MainWindow::on_actionClear_triggered()
 {
     ui->console->clear();
+    ui->hexDump->clear();
+    ui->console_decoded->clear();
 }
 
 void MainWindow::on_action_Re_Open_SerialPort_triggered()
@@ -862,9 +1553,7 @@ void MainWindow::on_actionAuto_Scroll_changed()
 
 void MainWindow::on_pushButton_clearCounters_clicked()
 {
-    numBytesRx = 0;
-    numBytesDroppedFromDisplay = 0;
-    numBytesTx = 0;
+    metrics.reset();
     updateCounterLabels();
 }
 
@@ -908,6 +1597,13 @@ void MainWindow::loadGeneralSettings()
     // Display mode
     initCheckableSetting(settingDisplayModeText, ui->radioButton_displayMode_text);
     initCheckableSetting(settingDisplayModeHex, ui->radioButton_displayMode_hex);
+    initCheckableSetting(settingDisplayModeHexDump, ui->radioButton_displayMode_hexDump);
+    int bytesPerRow = settings.value(settingHexDumpBytesPerRow,
+                                     ui->hexDump->bytesPerRow()).toInt();
+    ui->comboBox_hexDumpBytesPerRow->setCurrentIndex(
+                qMax(0, ui->comboBox_hexDumpBytesPerRow->findText(
+                         QString("%1 bytes/row").arg(bytesPerRow))));
+    updateDisplayView();
 
     // Text mode settings
     initCheckableSetting(settingHexSpecial, ui->checkBox_showHexForSpecialChars);
@@ -935,6 +1631,7 @@ void MainWindow::loadGeneralSettings()
     initLineEditSetting(settingUdpBindPort, ui->lineEdit_udp_listenPort);
     initCheckableSetting(settingUdpSendBroadcast, ui->checkBox_udp_broadcast);
     initLineEditSetting(settingUdpSendIp, ui->lineEdit_udp_sendIpAddress);
+    initLineEditSetting(settingUdpMulticastGroup, ui->lineEdit_udp_multicastGroup);
     initLineEditSetting(settingUdpSendPort, ui->lineEdit_udp_sendPort);
 
     // Send file settings
@@ -943,6 +1640,18 @@ void MainWindow::loadGeneralSettings()
     initCheckableSetting(settingSendFileExcludeEndingNewline, ui->checkBox_sendFile_excludeEndingNewline);
     initCheckableSetting(settingSendFileSendMsgIfFileEmpty, ui->checkBox_sendFile_sendMsgIfEmpty);
     initLineEditSetting(settingSendFileMsgIfEmpty, ui->lineEdit_sendFile_msgIfEmpty);
+
+    // Metrics export settings
+    initCheckableSetting(settingMetricsHttp, ui->checkBox_metrics_http);
+    initSpinBox(settingMetricsHttpPort, ui->spinBox_metrics_httpPort);
+    initCheckableSetting(settingMetricsJsonFile, ui->checkBox_metrics_jsonFile);
+    initSpinBox(settingMetricsJsonIntervalMs, ui->spinBox_metrics_jsonIntervalMs);
+    initLineEditSetting(settingMetricsJsonPath, ui->lineEdit_metrics_jsonPath);
+    updateMetricsExport();
+
+    // Display backlog spill setting
+    initCheckableSetting(settingDisplaySpill, ui->checkBox_displaySpill);
+    initSpinBox(settingDisplaySpillMaxMb, ui->spinBox_displaySpillMaxMb);
 }
 
 void MainWindow::updateWindowTitle()
@@ -1030,7 +1739,7 @@ void MainWindow::on_pushButton_startup_openSerialPort_clicked()
 
 void MainWindow::on_action_Open_Serial_Port_triggered()
 {
-    serial.refreshSerialPortList();
+    // The port list is refreshed when the dialog is shown
     serial.show();
 }
 
@@ -1046,6 +1755,7 @@ void MainWindow::on_pushButton_startup_tcpClient_clicked()
 
 void MainWindow::on_pushButton_startup_udp_clicked()
 {
+    updateMulticastInterfaces();
     ui->stackedWidget->setCurrentWidget(ui->page_udp);
 }
 
@@ -1075,7 +1785,10 @@ void MainWindow::on_pushButton_tcpClient_connect_clicked()
     int port = ui->lineEdit_tcpClient_port->text().toInt(&ok);
     if (!ok) { return; }
 
-    tcp.connectToServer(QHostAddress(ip), port);
+    reconnectSupervisor.stop();
+    mTcpClientAddress = QHostAddress(ip);
+    mTcpClientPort = port;
+    tcp.connectToServer(mTcpClientAddress, mTcpClientPort);
     setCommsModeAndUpdateGui(CommsTcpClient);
     updateWindowTitle();
 
@@ -1090,20 +1803,46 @@ void MainWindow::on_pushButton_udp_start_clicked()
     int listenPort = ui->lineEdit_udp_listenPort->text().toInt(&ok);
     if (!ok) { return; }
 
-    mUdpSendPort = ui->lineEdit_udp_sendPort->text().toInt(&ok);
+    int sendPort = ui->lineEdit_udp_sendPort->text().toInt(&ok);
     if (!ok) { return; }
 
+    // Send targets are parsed once here, not for every message. Without
+    // valid targets UDP can still be used for listening only.
+    QList<GidUdp::Target> targets;
+    udpTargetsError.clear();
+    if (ui->checkBox_udp_broadcast->isChecked()) {
+        targets.append({QHostAddress(QHostAddress::Broadcast), quint16(sendPort)});
+    } else if (!GidUdp::parseTargets(ui->lineEdit_udp_sendIpAddress->text(),
+                                     quint16(sendPort), &targets, &udpTargetsError)) {
+        targets.clear();
+    }
+
+    QHostAddress multicastGroup;
+    QString groupText = ui->lineEdit_udp_multicastGroup->text().trimmed();
+    if (!groupText.isEmpty()) {
+        multicastGroup = QHostAddress(groupText);
+        if (!multicastGroup.isMulticast()) {
+            QMessageBox::warning(this, "UDP", "Not a multicast address: " + groupText);
+            return;
+        }
+    }
+    QString interfaceName = ui->comboBox_udp_multicastInterface->currentData().toString();
+    settings.setValue(settingUdpMulticastInterface, interfaceName);
+
     // Bind to port for listening
     if (ui->checkBox_udp_bindForListening->isChecked()) {
-        udp.setupUdp(listenPort);
+        udp.setupUdp(listenPort, multicastGroup,
+                     QNetworkInterface::interfaceFromName(interfaceName));
     }
 
     // Setup sending
-    mUdpSendBroadcast = ui->checkBox_udp_broadcast->isChecked();
-    mUdpSendIp = ui->lineEdit_udp_sendIpAddress->text();
+    udp.setSendTargets(targets);
 
     setCommsModeAndUpdateGui(CommsUdp);
     printUdp("UDP mode initialised");
+    if (!udpTargetsError.isEmpty()) {
+        printUdp("Not sending: " + udpTargetsError);
+    }
     updateWindowTitle();
 
     showMainPage();
@@ -1131,6 +1870,9 @@ void MainWindow::on_action_New_Connection_triggered()
     stopTcpServer();
     disconnectFromTcpServer();
     stopUdp();
+    if (framer) { framer->reset(); }
+    if (decoder) { decoder->reset(); }
+    plotExtractor.reset();
 
     setCommsModeAndUpdateGui(CommsNone);
     updateWindowTitle();
@@ -1373,110 +2115,644 @@ void MainWindow::on_spinBox_displayBacklogLengthMs_valueChanged(int value)
     dataDisplay.displayBacklogLengthMs = value;
 }
 
-void MainWindow::DataDisplayProcessor::processData(QByteArray data,
-                                                   MainWindow::DataDirection dir)
+void MainWindow::on_checkBox_displaySpill_toggled(bool checked)
+{
+    dataDisplay.spillEnabled = checked;
+}
+
+void MainWindow::on_spinBox_displaySpillMaxMb_valueChanged(int value)
+{
+    dataDisplay.spillMaxBytes = qint64(value) * 1024 * 1024;
+}
+
+void MainWindow::on_pushButton_jumpToLive_clicked()
+{
+    dataDisplay.jumpToLive();
+}
+
+void MainWindow::on_spinBox_udp_displayRateLimit_valueChanged(int value)
+{
+    datagramLimiter.setRate(value);
+}
+
+void MainWindow::on_spinBox_guiRefreshRateHz_valueChanged(int value)
+{
+    guiRefreshRateHz = value;
+    if (presentationTimer.isActive()) {
+        presentationTimer.start(1000 / guiRefreshRateHz, this);
+    }
+}
+
+bool MainWindow::isHexDumpMode()
 {
-    bool start = (rxbuffer.isEmpty() && txbuffer.isEmpty());
+    return ui->radioButton_displayMode_hexDump->isChecked();
+}
 
-    if (dir == MainWindow::DataReceive) {
-        rxbuffer += data;
+void MainWindow::updateDisplayView()
+{
+    if (isHexDumpMode()) {
+        ui->stackedWidget_display->setCurrentWidget(ui->page_hexDump);
+        // Find searches the console text only
+        if (ui->widget_find->isVisible()) { closeFind(); }
     } else {
-        txbuffer += data;
+        ui->stackedWidget_display->setCurrentWidget(ui->page_console);
     }
+    ui->actionFind->setEnabled(!isHexDumpMode());
+}
 
-    if (start) { processNext(); }
+void MainWindow::displayReceived(const GidChunk& chunk)
+{
+    if (!chunk.tag.isEmpty()) {
+        displayDatagram(chunk);
+    } else if (framer) {
+        QList<GidChunk> frames;
+        numFrameErrorsRx->add(framer->feed(chunk, frames));
+        foreach (const GidChunk& frame, frames) {
+            numFramesRx->add();
+            frameSizeRx->record(frame.data.count());
+            displayData(frame, DataReceive);
+        }
+    } else {
+        displayData(chunk, DataReceive);
+    }
 }
 
-void MainWindow::DataDisplayProcessor::processNext()
+void MainWindow::displayData(const GidChunk& chunk, DataDirection dir)
 {
-    int sizeMin = 32;
+    if (isHexDumpMode()) {
+        ui->hexDump->append(chunk.data, dir == DataSend);
+        // Data in the hex dump is not formatted, so it is logged as is
+        if (logAsDisplayed) { log(chunk.data); }
+    } else {
+        dataDisplay.processData(chunk, dir);
+    }
+}
 
-    QElapsedTimer timer;
-    timer.start();
-    int countBefore = rxbuffer.count() + txbuffer.count();
-    while (timer.elapsed() < allowedMs) {
-        qint64 msBefore = timer.elapsed();
-
-        // Split number of bytes to be processed between incoming and outgoing.
-        int nrx = bufferProcessSize / 2;
-        int ntx = nrx;
-        if (txbuffer.count() < ntx) {
-            nrx += ntx - txbuffer.count();
+void MainWindow::on_radioButton_displayMode_hexDump_toggled(bool /*checked*/)
+{
+    updateDisplayView();
+}
+
+void MainWindow::on_comboBox_hexDumpBytesPerRow_currentIndexChanged(int index)
+{
+    int bytesPerRow = 8 << index;
+    ui->hexDump->setBytesPerRow(bytesPerRow);
+    settings.setValue(settingHexDumpBytesPerRow, bytesPerRow);
+}
+
+void MainWindow::on_actionFind_triggered()
+{
+    ui->widget_find->setVisible(true);
+    ui->lineEdit_find->setFocus();
+    ui->lineEdit_find->selectAll();
+    updateFindQuery();
+}
+
+void MainWindow::on_pushButton_findNext_clicked()
+{
+    consoleSearch->findNext();
+}
+
+void MainWindow::on_pushButton_findPrevious_clicked()
+{
+    consoleSearch->findPrevious();
+}
+
+void MainWindow::on_toolButton_findClose_clicked()
+{
+    closeFind();
+}
+
+void MainWindow::on_checkBox_metrics_http_clicked()
+{
+    updateMetricsExport();
+}
+
+void MainWindow::on_spinBox_metrics_httpPort_editingFinished()
+{
+    updateMetricsExport();
+}
+
+void MainWindow::on_checkBox_metrics_jsonFile_clicked()
+{
+    updateMetricsExport();
+}
+
+void MainWindow::on_spinBox_metrics_jsonIntervalMs_editingFinished()
+{
+    updateMetricsExport();
+}
+
+void MainWindow::on_lineEdit_metrics_jsonPath_editingFinished()
+{
+    updateMetricsExport();
+}
+
+void MainWindow::updateMetricsExport()
+{
+    if (ui->checkBox_metrics_http->isChecked()) {
+        metricsExporter.startHttp(ui->spinBox_metrics_httpPort->value());
+    } else {
+        metricsExporter.stopHttp();
+    }
+
+    QString jsonPath = ui->lineEdit_metrics_jsonPath->text();
+    if (ui->checkBox_metrics_jsonFile->isChecked() && !jsonPath.isEmpty()) {
+        metricsExporter.startJsonFile(jsonPath,
+                                      ui->spinBox_metrics_jsonIntervalMs->value());
+    } else {
+        metricsExporter.stopJsonFile();
+    }
+}
+
+void MainWindow::onMetricsTimer()
+{
+    metrics.tick();
+
+    ui->label_rateRx->setText(QString("%1/s, %2 chunks/s")
+                              .arg(Utilities::bytesToString(rateBytesRx->value()))
+                              .arg(rateChunksRx->value(), 0, 'f', 1));
+    ui->label_rateTx->setText(QString("%1/s, %2 chunks/s")
+                              .arg(Utilities::bytesToString(rateBytesTx->value()))
+                              .arg(rateChunksTx->value(), 0, 'f', 1));
+
+    quint64 n = displayProcessTimeUs->count();
+    if (n) {
+        ui->label_displayProcessTimeStats->setText(
+                    QString("avg %1 us, max %2 us")
+                    .arg(displayProcessTimeUs->sum() / n)
+                    .arg(displayProcessTimeUs->max()));
+    } else {
+        ui->label_displayProcessTimeStats->setText("-");
+    }
+
+    if (decoder) {
+        ui->label_decoderStats->setText(QString("%1 messages, %2 checksum errors")
+                                        .arg(numDecodedMessages->value())
+                                        .arg(numChecksumErrors->value()));
+    } else {
+        ui->label_decoderStats->setText("-");
+    }
+
+    if (patternTestTimer.isActive()) {
+        updatePatternTestStats();
+    }
+
+    if (latencyStatsDirty) {
+        latencyStatsDirty = false;
+        updateLatencyStats();
+    }
+
+    updateReconnectStats();
+
+    qint64 nowUs = GidTimestamp::now().monotonicUs();
+    foreach (const GidDatagramLimiter::Summary& s, datagramLimiter.takeSummaries(nowUs)) {
+        showDatagramSummary(s);
+    }
+
+    // The socket's count restarts when it is bound again
+    qint64 drops = (mCommsMode == CommsUdp) ? udp.kernelDrops() : -1;
+    if (drops >= 0) {
+        if (drops < udpKernelDropsReported) { udpKernelDropsReported = 0; }
+        udpKernelDrops->add(drops - udpKernelDropsReported);
+        udpKernelDropsReported = drops;
+        ui->label_udpKernelDrops->setText(QString::number(udpKernelDrops->value()));
+    } else {
+        ui->label_udpKernelDrops->setText("-");
+    }
+
+    // Measured rates relative to what the line can carry at the configured
+    // baud rate and character format
+    if ((mCommsMode == CommsSerial) && serial.s.isOpen()) {
+        double capacity = serial.lineCapacity();
+        ui->progressBar_utilizationRx->setValue(
+                    qMin(100, qRound(rateBytesRx->value() * 100 / capacity)));
+        ui->progressBar_utilizationTx->setValue(
+                    qMin(100, qRound(rateBytesTx->value() * 100 / capacity)));
+        ui->label_lineCapacity->setText(
+                    QString("of %1/s").arg(Utilities::bytesToString(capacity)));
+    } else {
+        ui->progressBar_utilizationRx->setValue(0);
+        ui->progressBar_utilizationTx->setValue(0);
+        ui->label_lineCapacity->setText("-");
+    }
+
+    // The port's stats restart when it is opened
+    const GidQt5Serial::FlowControlStats& flow = serial.flowControlStats();
+    if (flow.stalls < serialFlowReported.stalls) {
+        serialFlowReported = GidQt5Serial::FlowControlStats();
+    }
+    serialFlowBlockedUs->add(flow.blockedUs - serialFlowReported.blockedUs);
+    serialFlowStalls->add(flow.stalls - serialFlowReported.stalls);
+    serialFlowReported = flow;
+    if (serial.s.isOpen() && (serial.s.flowControl() != QSerialPort::NoFlowControl)) {
+        bool software = (serial.s.flowControl() == QSerialPort::SoftwareControl);
+        ui->label_flowControlStats->setText(
+                    QString("%1blocked %2, %3 %4")
+                    .arg(flow.blocked ? "BLOCKED, " : "")
+                    .arg(Utilities::usToString(flow.blockedUs))
+                    .arg(flow.stalls)
+                    .arg(software ? "XOFF" : "stalls"));
+    } else {
+        ui->label_flowControlStats->setText("-");
+    }
+
+    if (framer) {
+        ui->label_rateFrames->setText(QString("%1 frames/s, %2 errors")
+                                      .arg(rateFramesRx->value(), 0, 'f', 1)
+                                      .arg(numFrameErrorsRx->value()));
+    } else {
+        ui->label_rateFrames->setText("-");
+    }
+}
+
+MainWindow::DataDisplayProcessor::DataDisplayProcessor(MainWindow* mw) :
+    mainWindow(mw)
+{
+    QObject::connect(&formatWatcher, &QFutureWatcherBase::finished, mainWindow,
+                     [=]() { onFormatted(); });
+}
+
+MainWindow::DataDisplayProcessor::~DataDisplayProcessor()
+{
+    // The batch being formatted uses the formatter
+    formatWatcher.waitForFinished();
+}
+
+void MainWindow::DataDisplayProcessor::processData(GidChunk chunk,
+                                                   MainWindow::DataDirection dir)
+{
+    if (chunk.data.isEmpty() && chunk.tag.isEmpty()) { return; }
+
+    enqueue(chunk, (dir == MainWindow::DataSend) ? GidConsoleFormatter::Send
+                                                 : GidConsoleFormatter::Receive);
+}
+
+void MainWindow::DataDisplayProcessor::processDecoded(
+        const QString& decoder, const GidProtocolDecoder::Message& m)
+{
+    GidChunk chunk(m.text.toUtf8(), m.timestamp, true);
+    chunk.tag = decoder;
+    enqueue(chunk, m.checksumOk ? GidConsoleFormatter::Decoded
+                                : GidConsoleFormatter::DecodedError);
+}
+
+void MainWindow::DataDisplayProcessor::enqueue(const GidChunk& chunk,
+                                               GidConsoleFormatter::Direction d)
+{
+    // While behind, new data goes after what was spilled to keep the order
+    if (!spill.isEmpty()) {
+        Entry e {nextSeq++, chunk, d, 0, 0};
+        // Once a chunk is held, the ones after it are held too
+        if (!held.isEmpty() || !spillEntry(e)) {
+            held.enqueue(e);
+            heldBytes += chunk.data.count();
         }
-        if (rxbuffer.count() < nrx) {
-            ntx += nrx - rxbuffer.count();
+        spillChanged();
+        formatNext();
+        return;
+    }
+
+    queue.enqueue({nextSeq++, chunk, d, 0, 0});
+    queuedBytes += chunk.data.count();
+
+    formatNext();
+}
+
+/* Move up to n bytes from the front of the queue to the batch. Chunks are
+ * taken whole where possible so they keep their own timestamps. If a chunk is
+ * only partially taken, the rest of it stays in front with the same
+ * timestamp. Returns the number of bytes taken. */
+int MainWindow::DataDisplayProcessor::take(int n, QList<Piece>& batch)
+{
+    int taken = 0;
+    while ((taken < n) && !queue.isEmpty()) {
+        Entry& front = queue.head();
+
+        // Chunks dropped before this one are noted in its place
+        int gapChunks = 0;
+        qint64 gapBytes = 0;
+        if (front.offset == 0) {
+            gapChunks = int(front.seq - displaySeq);
+            gapBytes = droppedBytes + front.gapBytes;
+            droppedBytes = 0;
+            front.gapBytes = 0;
+            displaySeq = front.seq + 1;
         }
 
-        // Process incoming
-        QByteArray data = rxbuffer.left(nrx);
-        rxbuffer.remove(0, nrx);
-        mainWindow->addDataToConsole(data, DataReceive);
-        int dataCount = data.count();
-
-        // Process outgoing
-        data = txbuffer.left(ntx);
-        txbuffer.remove(0, ntx);
-        mainWindow->addDataToConsole(data, DataSend);
-        dataCount += data.count();
-
-        qint64 msAfter = timer.elapsed();
-
-        // Adjust buffer process size (number of bytes processed per cycle) to
-        // keep within allowed time slot
-        int dt = qMax(qint64(1), msAfter - msBefore);
-        if (dt > 0) {
-            int rate = dataCount / dt;
-            bufferProcessSize = rate * allowedMs;
-            if (bufferProcessSize < sizeMin) { bufferProcessSize = sizeMin; }
+        // Decoded messages are always taken whole
+        bool whole = (front.dir == GidConsoleFormatter::Decoded)
+                  || (front.dir == GidConsoleFormatter::DecodedError);
+        int remaining = front.chunk.data.count() - front.offset;
+        if (whole || (remaining <= (n - taken))) {
+            Entry e = queue.dequeue();
+            if (e.offset) { e.chunk.data = e.chunk.data.mid(e.offset); }
+            batch.append({e.chunk, e.dir, gapChunks, gapBytes});
+            taken += remaining;
+        } else {
+            int size = n - taken;
+            GidChunk piece(front.chunk.data.mid(front.offset, size),
+                           front.chunk.timestamp, front.chunk.frameStart);
+            piece.tag = front.chunk.tag;
+            front.chunk.frameStart = false;
+            front.offset += size;
+            batch.append({piece, front.dir, gapChunks, gapBytes});
+            taken += size;
         }
+    }
+    queuedBytes -= taken;
+    return taken;
+}
+
+/* Drop whole entries from the front of the queue until at least n bytes are
+ * dropped. Returns the number of bytes dropped. */
+int MainWindow::DataDisplayProcessor::drop(int n)
+{
+    int dropped = 0;
+    while ((dropped < n) && !queue.isEmpty()) {
+        Entry e = queue.dequeue();
+        dropped += e.chunk.data.count() - e.offset;
+        droppedBytes += e.gapBytes;
+    }
+    queuedBytes -= dropped;
+    noteDropped(dropped);
+    return dropped;
+}
 
-        if ((msAfter + dt) > allowedMs) { break; }
-        if (rxbuffer.isEmpty() && txbuffer.isEmpty()) { break; }
+/* Dropped bytes are noted before the entry that follows them, or before the
+ * front of the queue if next is null. The number of chunks dropped follows
+ * from the sequence numbers when the entry is displayed. */
+void MainWindow::DataDisplayProcessor::noteDropped(qint64 bytes, Entry* next)
+{
+    if (next) {
+        next->gapBytes += bytes;
+    } else {
+        droppedBytes += bytes;
     }
+    mainWindow->numBytesDroppedFromDisplay->add(bytes);
+    mainWindow->counterLabelsDirty = true;
+}
+
+/* Start formatting the next batch on a worker thread, unless one is being
+ * formatted already. The formatter gets the display options as they are now,
+ * so it doesn't access any widgets. */
+void MainWindow::DataDisplayProcessor::formatNext()
+{
+    if (formatting) { return; }
+    if (!spill.isEmpty() && (queuedBytes < bufferProcessSize)) { pageIn(); }
+    if (queue.isEmpty()) { return; }
+
+    QList<Piece> batch;
+    batchBytes = take(bufferProcessSize, batch);
+
+    GidConsoleFormatter::Options options = mainWindow->displayOptions;
+    bool startNewLine = newLine;
+    newLine = false;
+    GidConsoleFormatter* f = &formatter;
+
+    formatting = true;
+    batchTimer.start();
+    formatWatcher.setFuture(QtConcurrent::run([=]()
+    {
+        f->setOptions(options);
+        if (startNewLine) { f->startNewLine(); }
+        Segments segments;
+        foreach (const Piece& piece, batch) {
+            if (piece.gapBytes) {
+                f->formatGap(piece.gapChunks, piece.gapBytes, segments);
+            }
+            f->format(piece.chunk, piece.dir, segments);
+        }
+        return segments;
+    }));
+}
+
+void MainWindow::DataDisplayProcessor::onFormatted()
+{
+    int sizeMin = 32;
+
+    Segments segments = formatWatcher.result();
+    formatting = false;
+    int bytes = batchBytes;
+    qint64 batchMs = batchTimer.elapsed();
+
+    // Format the next batch while this one is added to the console
+    formatNext();
+
+    QElapsedTimer timer;
+    timer.start();
+    mainWindow->addFormattedToConsole(segments);
     lastProcessMs = timer.elapsed();
 
-    // Drop calculation
-    int countAfter = rxbuffer.count() + txbuffer.count();
-    int bufmax = 0;
+    // Adjust buffer process size (number of bytes per batch) to keep adding a
+    // batch within the allowed time slot
+    int dt = qMax(qint64(1), timer.elapsed());
+    int rate = bytes / dt;
+    bufferProcessSize = rate * allowedMs;
+    if (bufferProcessSize < sizeMin) { bufferProcessSize = sizeMin; }
+
+    // Drop calculation, based on how long the batch took from being taken
+    // from the queue to being displayed
+    int countAfter = queuedBytes;
+    bufmax = 0;
     if (countAfter > 0) {
-        int ms = timer.elapsed();
+        qint64 ms = batchMs + timer.elapsed();
         if (ms > 0) {
-            float bpms = (countBefore - countAfter) / (float)ms;
+            float bpms = bytes / (float)ms;
             bufmax = bpms * displayBacklogLengthMs;
         }
     }
 
-    if (countAfter > bufmax) {
-        int drop = countAfter - bufmax;
-        // First drop from send display buffer
-        int dropTx = qMin(txbuffer.count(), drop);
-        int dropRx = qMin(rxbuffer.count(), drop - dropTx);
-        txbuffer.remove(0, dropTx);
-        rxbuffer.remove(0, dropRx);
-        mainWindow->numBytesDroppedFromDisplay += drop;
-        mainWindow->updateCounterLabels();
+    if (!spill.isEmpty()) {
+        // The queue only holds data paged in from the spill file. Chunks
+        // that could not be spilled are held to the backlog length.
+        if (bufmax && (heldBytes > bufmax)) { dropHeld(heldBytes - bufmax); }
+    } else if (countAfter > bufmax) {
+        if (spillEnabled) {
+            spillBacklog(countAfter - bufmax);
+        } else {
+            drop(countAfter - bufmax);
+        }
+    }
+    mainWindow->displayProcessTimeUs->record(timer.nsecsElapsed() / 1000);
+    mainWindow->displayBacklogBytes->set(queuedBytes);
+
+    // GUI information is updated on the next presentation frame
+    mainWindow->displayProcessorLabelsDirty = true;
+    mainWindow->requestFrame();
+}
+
+/* Move the newest entries, at least n bytes, from the queue to the spill
+ * file. The front entry stays, as it may be partially taken. */
+void MainWindow::DataDisplayProcessor::spillBacklog(int n)
+{
+    QList<Entry> moved;
+    int bytes = 0;
+    while ((bytes < n) && (queue.count() > 1)) {
+        Entry e = queue.takeLast();
+        bytes += e.chunk.data.count();
+        moved.prepend(e);
+    }
+    queuedBytes -= bytes;
+
+    for (int i = 0; i < moved.count(); i++) {
+        if (spillEntry(moved.at(i))) { continue; }
+        if (spill.isEmpty()) {
+            // Nothing was spilled, so the backlog is dropped as usual
+            foreach (const Entry& e, moved) { queue.enqueue(e); }
+            queuedBytes += bytes;
+            drop(n);
+        } else {
+            // The rest wait until what was spilled has been read
+            for (; i < moved.count(); i++) {
+                held.enqueue(moved.at(i));
+                heldBytes += moved.at(i).chunk.data.count();
+            }
+        }
+        break;
+    }
+    spillChanged();
+}
+
+/* Returns false if the entry was not spilled because the file is full or
+ * can't be written. */
+bool MainWindow::DataDisplayProcessor::spillEntry(const Entry& e)
+{
+    if (spill.bytes() + e.chunk.data.count() > spillMaxBytes) {
+        if (!spillFullReported) {
+            mainWindow->print(QString("[display] Spill file is full (%1). Display "
+                                      "backlog is dropped until it catches up.")
+                              .arg(Utilities::bytesToString(spillMaxBytes)),
+                              Qt::darkGray);
+            spillFullReported = true;
+        }
+        return false;
+    }
+    if (spill.append({e.seq, e.chunk, quint8(e.dir),
+                      e.gapBytes})) {
+        return true;
+    }
+    spillError();
+    return false;
+}
+
+/* Drop whole held entries from the front until at least n bytes are dropped.
+ * The last entry stays so the dropped bytes can be noted before it. Returns
+ * the number of bytes dropped. */
+int MainWindow::DataDisplayProcessor::dropHeld(int n)
+{
+    int dropped = 0;
+    qint64 gapBytes = 0;
+    while ((dropped < n) && (held.count() > 1)) {
+        Entry e = held.dequeue();
+        dropped += e.chunk.data.count();
+        gapBytes += e.gapBytes;
+    }
+    heldBytes -= dropped;
+    if (dropped || gapBytes) {
+        held.head().gapBytes += gapBytes;
+        noteDropped(dropped, &held.head());
+    }
+    return dropped;
+}
+
+// Page spilled data back into the queue, a few batches at a time
+void MainWindow::DataDisplayProcessor::pageIn()
+{
+    int limit = qMax(bufferProcessSize * 4, 65536);
+    GidSpillFile::Record r;
+    while ((queuedBytes < limit) && !spill.isEmpty()) {
+        if (!spill.takeFirst(&r)) {
+            // What is left in the file can't be read back. It is dropped once
+            // the queue is empty, so it is noted in the right place.
+            spillError();
+            if (queue.isEmpty()) { dropSpilled(); }
+            break;
+        }
+        GidConsoleFormatter::Direction d = GidConsoleFormatter::Direction(r.kind);
+        queue.enqueue({r.seq, r.chunk, d, 0, r.gapBytes});
+        queuedBytes += r.chunk.data.count();
+    }
+    if (spill.isEmpty()) {
+        releaseHeld();
+        spillFullReported = false;
+    }
+    spillChanged();
+}
+
+// Held chunks follow what was in the spill file
+void MainWindow::DataDisplayProcessor::releaseHeld()
+{
+    while (!held.isEmpty()) { queue.enqueue(held.dequeue()); }
+    queuedBytes += heldBytes;
+    heldBytes = 0;
+}
+
+// Drop what is in the spill file. Must only be called with an empty queue.
+void MainWindow::DataDisplayProcessor::dropSpilled()
+{
+    if (spill.isEmpty()) { return; }
+    droppedBytes += spill.gapBytes();
+    noteDropped(spill.bytes());
+    spill.clear();
+}
+
+// Skip the data that the display is behind on. It is noted like dropped data.
+void MainWindow::DataDisplayProcessor::jumpToLive()
+{
+    if (spill.isEmpty()) { return; }
+
+    foreach (const Entry& e, queue) { droppedBytes += e.gapBytes; }
+    foreach (const Entry& e, held) { droppedBytes += e.gapBytes; }
+    droppedBytes += spill.gapBytes();
+    noteDropped(queuedBytes + spill.bytes() + heldBytes);
+    queue.clear();
+    queuedBytes = 0;
+    spill.clear();
+    held.clear();
+    heldBytes = 0;
+    spillFullReported = false;
+
+    spillChanged();
+}
+
+// Spilling is turned off after an error, so the backlog is dropped instead
+void MainWindow::DataDisplayProcessor::spillError()
+{
+    if (!spillEnabled) { return; }
+    spillEnabled = false;
+    mainWindow->ui->checkBox_displaySpill->setChecked(false);
+    mainWindow->print("[display] Spill file error: " + spill.errorString()
+                      + ". Display backlog is dropped instead.", Qt::red);
+}
+
+void MainWindow::DataDisplayProcessor::spillChanged()
+{
+    mainWindow->displaySpilledBytes->set(spill.bytes());
+    mainWindow->displayProcessorLabelsDirty = true;
+    mainWindow->requestFrame();
+}
+
+void MainWindow::DataDisplayProcessor::updateGuiInfo()
+{
+    bool behind = !spill.isEmpty();
+    mainWindow->ui->widget_behind->setVisible(behind);
+    if (behind) {
+        mainWindow->ui->label_behind->setText(
+                    QString("%1 behind, catching up")
+                    .arg(Utilities::bytesToString(spill.bytes() + heldBytes + queuedBytes)));
     }
 
-    // Update GUI information
     mainWindow->ui->label_displayProcessBufferSize->setText(
                 QString("%1").arg(bufferProcessSize));
     mainWindow->ui->label_lastDisplayProcessTime->setText(
                 QString("%1 ms").arg(lastProcessMs));
     int percent = 0;
     if (bufmax) {
-        percent = (float)(rxbuffer.count() + txbuffer.count())
-                / (float)bufmax * 100.0;
+        percent = (float)queuedBytes / (float)bufmax * 100.0;
     }
     mainWindow->ui->label_backlogFill->setText(
                 QString("%1 bytes (%2 %)")
-                .arg(rxbuffer.count() + txbuffer.count())
+                .arg(queuedBytes)
                 .arg(percent));
-
-    // Queue next call to this function so rest of GUI has a chance to run.
-    if (!rxbuffer.isEmpty() || !txbuffer.isEmpty()) {
-        QMetaObject::invokeMethod(mainWindow, [=]()
-        {
-            processNext();
-        }, Qt::QueuedConnection);
-    }
 }
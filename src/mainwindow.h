@@ -22,21 +22,41 @@
 #define MAINWINDOW_H
 
 #include "aboutdialog.h"
+#include "gidchunk.h"
+#include "gidconsoleformatter.h"
+#include "gidconsolesearch.h"
+#include "giddatagramlimiter.h"
+#include "gidframer.h"
+#include "gidhexdumpwidget.h"
+#include "gidlatencyprobe.h"
+#include "gidmessagecompiler.h"
+#include "gidmetrics.h"
+#include "gidpatterntest.h"
+#include "gidplotwidget.h"
+#include "gidprotocoldecoder.h"
 #include "gidqt5serial.h"
+#include "gidreconnectsupervisor.h"
+#include "gidsettings.h"
+#include "gidspillfile.h"
+#include "gidstartupprofile.h"
 #include "gidtcp.h"
 #include "gidudp.h"
 #include "version.h"
 
 #include <QBasicTimer>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QInputDialog>
 #include <QMainWindow>
 #include <QMap>
 #include <QNetworkInterface>
+#include <QQueue>
+#include <QScopedPointer>
 #include <QSerialPort>
 #include <QSerialPortInfo>
-#include <QSettings>
+#include <QSet>
 #include <QSpinBox>
 
 
@@ -56,6 +76,7 @@ public:
         QSerialPort::Parity parity = QSerialPort::NoParity;
         QSerialPort::DataBits dataBits = QSerialPort::Data8;
         QSerialPort::StopBits stopBits = QSerialPort::OneStop;
+        QSerialPort::FlowControl flowControl = QSerialPort::NoFlowControl;
         QString sendFilePath;
         int sendFileFreqMs = 500;
     };
@@ -67,11 +88,16 @@ private:
     Ui::MainWindow *ui;
     QString mAutoReplyBuffer;
 
-    QSettings settings;
+    GidSettings settings;
     void loadGeneralSettings();
 
     AboutDialog* aboutDialog = nullptr;
 
+    GidConsoleSearch* consoleSearch = nullptr;
+    void setupFind();
+    void updateFindQuery();
+    void closeFind();
+
     void showStartupPage();
     void showMainPage();
 
@@ -81,12 +107,16 @@ private:
     void updateWindowTitle();
 
     void print(QString msg, QColor c = Qt::black);
+
+    /* Display options are copied from the widgets when they change, so data
+     * is formatted without querying widgets for every byte. */
+    GidConsoleFormatter::Options displayOptions;
+    bool logAsDisplayed = false;
+    void setupDisplayOptions();
+    void updateDisplayOptions();
+
     enum DataDirection { DataReceive, DataSend };
-    void addDataToConsole(QByteArray data, DataDirection dataDir);
-    void addNonBreakingTextToConsole(QString text, QColor color,
-                                     bool virtuallyAtLineStart = false,
-                                     bool addSpaceBefore = false);
-    bool mLastRxDataAddedToConsoleWasNewline = false;
+    void addFormattedToConsole(const QList<GidConsoleFormatter::Segment>& segments);
     void addTextToConsoleAndLogIfEnabled(QString text, QColor color = Qt::black);
 
     // Generic receive/send
@@ -95,51 +125,293 @@ private:
     CommsMode mCommsMode = CommsNone;
     void setCommsModeAndUpdateGui(CommsMode mode);
 
-    int numBytesRx = 0;
-    int numBytesDroppedFromDisplay = 0;
-    int numBytesTx = 0;
-    bool lastWasHex = false;
+    // In hex dump mode, data bypasses the display processor and the raw bytes
+    // are added to the hex dump widget, which formats rows as they are shown.
+    bool isHexDumpMode();
+    void updateDisplayView();
+    void displayData(const GidChunk& chunk, DataDirection dir);
+    void displayReceived(const GidChunk& chunk);
+
+    // Received data is split into frames if a framer is set up
+    QScopedPointer<GidFramer> framer;
+    void setupFraming();
+    void updateFramer();
+
+    // Escape sequences and checksums in sent messages
+    GidMessageCompiler messageCompiler;
+    QByteArray replaceEscapeSequences(QByteArray data);
+
+    // Protocol decoder running on the received byte stream
+    QScopedPointer<GidProtocolDecoder> decoder;
+    QBasicTimer decoderIdleTimer;
+    void updateDecoder();
+    void onDecoderIdleTimer();
+    void showDecodedMessages(const QList<GidProtocolDecoder::Message>& messages);
+
+    // Datagrams shown one per line, limited per sender
+    GidDatagramLimiter datagramLimiter;
+    void displayDatagram(const GidChunk& chunk);
+    void showDatagramSummary(const GidDatagramLimiter::Summary& summary);
+
+    // Numeric values are extracted from received lines before they are
+    // displayed, so they can be plotted with the console display turned off.
+    GidPlotExtractor plotExtractor;
+    void setupPlot();
+    void updatePlotPattern();
+
+    // Tabs only used from their own controls are set up when first shown
+    QSet<QWidget*> toolTabsSetUp;
+    void setupToolTab(QWidget* tab);
+
+    // Round-trip latency measurement with request/response messages
+    GidLatencyProbe latencyProbe;
+    // Keeps running after Stop until pending requests are answered or expire
+    QBasicTimer latencyTimer;
+    bool latencySending = false;
+    bool latencyStatsDirty = false;
+    void setupLatency();
+    void onLatencyTimer();
+    void updateLatencyStats();
+
+    // Pattern generator and verifier for testing links
+    GidPatternGenerator patternGenerator;
+    QScopedPointer<GidPatternVerifier> patternVerifier;
+    QBasicTimer patternTestTimer;
+    QElapsedTimer patternTestElapsed;
+    double patternTestSeconds = 0;
+    qint64 patternTestBytesSent = 0;
+    qint64 patternTestBytesReceived = 0;
+    void setupPatternTest();
+    void onPatternTestTimer();
+    void updatePatternTestStats();
     void updateCounterLabels();
 
-    QElapsedTimer lastTimestamp;
+    /* GUI state that changes with every chunk of data (counters, display
+     * statistics, console scrolling and repainting) is not updated directly.
+     * It is marked dirty and presented at a fixed refresh rate so the cost of
+     * refreshing the GUI does not grow with the chunk rate. */
+    int guiRefreshRateHz = 30;
+    QBasicTimer presentationTimer;
+    bool counterLabelsDirty = false;
+    bool displayProcessorLabelsDirty = false;
+    void requestFrame();
+    void onPresentationTimer();
+
+    // Metrics
+    GidMetrics metrics;
+    GidMetrics::Counter* numBytesRx = metrics.addCounter(
+                "simpleserial_rx_bytes_total", "Bytes received");
+    GidMetrics::Counter* numChunksRx = metrics.addCounter(
+                "simpleserial_rx_chunks_total", "Chunks of data received");
+    GidMetrics::Counter* numBytesTx = metrics.addCounter(
+                "simpleserial_tx_bytes_total", "Bytes sent");
+    GidMetrics::Counter* numChunksTx = metrics.addCounter(
+                "simpleserial_tx_chunks_total", "Chunks of data sent");
+    GidMetrics::Counter* numBytesDroppedFromDisplay = metrics.addCounter(
+                "simpleserial_display_dropped_bytes_total",
+                "Bytes dropped from the display backlog");
+    GidMetrics::Counter* numFramesRx = metrics.addCounter(
+                "simpleserial_rx_frames_total", "Frames received");
+    GidMetrics::Counter* numFrameErrorsRx = metrics.addCounter(
+                "simpleserial_rx_frame_errors_total",
+                "Invalid or oversized frames discarded");
+    GidMetrics::Counter* numDecodedMessages = metrics.addCounter(
+                "simpleserial_decoder_messages_total", "Messages decoded");
+    GidMetrics::Counter* numChecksumErrors = metrics.addCounter(
+                "simpleserial_decoder_checksum_errors_total",
+                "Decoded messages with a CRC or checksum error");
+    GidMetrics::Counter* serialFlowBlockedUs = metrics.addCounter(
+                "simpleserial_serial_flow_blocked_us_total",
+                "Time serial transmission was blocked by flow control");
+    GidMetrics::Counter* serialFlowStalls = metrics.addCounter(
+                "simpleserial_serial_flow_stalls_total",
+                "Times serial transmission was stopped by flow control (XOFF "
+                "or CTS deasserted)");
+    // Serial flow control stats already added to the counters above
+    GidQt5Serial::FlowControlStats serialFlowReported;
+    GidMetrics::Counter* numReconnects = metrics.addCounter(
+                "simpleserial_reconnects_total",
+                "Times a lost serial port or TCP client connection was reconnected");
+    GidMetrics::Counter* udpKernelDrops = metrics.addCounter(
+                "simpleserial_udp_kernel_drops_total",
+                "UDP datagrams dropped by the kernel because the receive buffer "
+                "was full");
+    // Kernel drop count of the UDP socket already added to the counter above
+    qint64 udpKernelDropsReported = 0;
+    GidMetrics::Counter* reconnectDowntimeUs = metrics.addCounter(
+                "simpleserial_reconnect_downtime_us_total",
+                "Time connections were down before being reconnected");
+    GidMetrics::Rate* rateBytesRx = metrics.addRate(
+                "simpleserial_rx_bytes_per_second", "Receive rate", numBytesRx);
+    GidMetrics::Rate* rateChunksRx = metrics.addRate(
+                "simpleserial_rx_chunks_per_second", "Receive chunk rate", numChunksRx);
+    GidMetrics::Rate* rateFramesRx = metrics.addRate(
+                "simpleserial_rx_frames_per_second", "Receive frame rate", numFramesRx);
+    GidMetrics::Rate* rateBytesTx = metrics.addRate(
+                "simpleserial_tx_bytes_per_second", "Send rate", numBytesTx);
+    GidMetrics::Rate* rateChunksTx = metrics.addRate(
+                "simpleserial_tx_chunks_per_second", "Send chunk rate", numChunksTx);
+    GidMetrics::Histogram* chunkSizeRx = metrics.addHistogram(
+                "simpleserial_rx_chunk_size_bytes", "Size of received chunks");
+    GidMetrics::Histogram* frameSizeRx = metrics.addHistogram(
+                "simpleserial_rx_frame_size_bytes", "Size of received frames");
+    GidMetrics::Histogram* chunkSizeTx = metrics.addHistogram(
+                "simpleserial_tx_chunk_size_bytes", "Size of sent chunks");
+    GidMetrics::Histogram* displayProcessTimeUs = metrics.addHistogram(
+                "simpleserial_display_process_time_us",
+                "Time spent per display processing cycle");
+    GidMetrics::Gauge* displayBacklogBytes = metrics.addGauge(
+                "simpleserial_display_backlog_bytes",
+                "Bytes waiting to be displayed");
+    GidMetrics::Gauge* displaySpilledBytes = metrics.addGauge(
+                "simpleserial_display_spilled_bytes",
+                "Bytes of the display backlog in the spill file");
+    GidMetrics::Gauge* logQueueBytes = metrics.addGauge(
+                "simpleserial_log_queue_bytes",
+                "Bytes waiting to be written to the log file on last flush");
+    GidMetrics::Gauge* connectionDown = metrics.addGauge(
+                "simpleserial_connection_down",
+                "1 while a lost connection is being reconnected");
+    GidMetricsExporter metricsExporter {&metrics};
+    QBasicTimer metricsTimer;
+    void onMetricsTimer();
+    void updateMetricsExport();
+
+    GidTimestampFormatter timestampFormatter;
 
     void sendMacro(QString text);
 
     /* DataDisplayProcessor displays data in the console asynchronously so the
      * rest of the application doesn't block if large amounts af data is
      * displayed.
-     * allowedMs specifies the time allowed for blocked processing.
+     * Received and sent chunks wait in a single queue in the order they
+     * occurred, so request/response exchanges are displayed as they happened.
+     * Data is formatted in batches by a GidConsoleFormatter on a worker
+     * thread. The GUI thread only appends the formatted text to the console.
+     * While one batch is appended, the next one is formatted.
+     * allowedMs specifies the time allowed for appending a batch.
      * Keeping this low will ensure a responsive GUI.
      * displayBacklogLengthMs specifies how much data can pile up before data
-     * will be dropped from the buffers.
-     * The number of bytes processed is varied dynamically so allowedMs is not
-     * exceeded. Processing time is shared between outgoing and incoming data,
-     * but when buffers are dropped, outgoing is dropped first.
+     * will be dropped from the queue.
+     * The number of bytes per batch is varied dynamically so allowedMs is not
+     * exceeded. When data is dropped, whole chunks are dropped from the front
+     * of the queue and a note is displayed in their place.
+     * With spillEnabled, the backlog beyond displayBacklogLengthMs is moved to
+     * a temporary file instead of dropped. While the file holds data, new
+     * data is added to it too, and it is paged back into the queue as the
+     * queue runs low, until the display has caught up. jumpToLive() skips
+     * what is in the file. The file is limited to spillMaxBytes. When it is
+     * full or can't be written, later data waits in memory until the file
+     * has been read, and is dropped beyond the backlog length.
      * */
     struct DataDisplayProcessor {
-        DataDisplayProcessor(MainWindow* mw) : mainWindow(mw) {}
-        void processData(QByteArray data, MainWindow::DataDirection dir);
+        DataDisplayProcessor(MainWindow* mw);
+        ~DataDisplayProcessor();
+        void processData(GidChunk chunk, MainWindow::DataDirection dir);
+        // Decoded messages are queued with the data so they follow it
+        void processDecoded(const QString& decoder,
+                            const GidProtocolDecoder::Message& m);
+        // Text other than data was added to the console, ending with a newline
+        void startNewLine() { newLine = true; }
+        void jumpToLive();
+        void updateGuiInfo();
+        bool spillEnabled = false;
+        qint64 spillMaxBytes = 1024LL * 1024 * 1024;
         int allowedMs = 25;
         int displayBacklogLengthMs = 5000;
     private:
         MainWindow* mainWindow = nullptr;
-        void processNext();
+        // Only used by the batch being formatted
+        GidConsoleFormatter formatter;
+        typedef QList<GidConsoleFormatter::Segment> Segments;
+        QFutureWatcher<Segments> formatWatcher;
+        bool formatting = false;
+        bool newLine = false;
+        int batchBytes = 0;
+        QElapsedTimer batchTimer;
+        void formatNext();
+        void onFormatted();
+        void enqueue(const GidChunk& chunk, GidConsoleFormatter::Direction dir);
         int bufferProcessSize = 1024;
         int lastProcessMs = 0;
-        QByteArray rxbuffer;
-        QByteArray txbuffer;
+        int bufmax = 0;
+        /* Chunks keep their timestamps while waiting to be displayed. The
+         * data of a chunk is shared, not copied. offset is the number of bytes
+         * of a partially taken chunk that have been taken already. gapBytes
+         * is the number of bytes dropped right before the chunk. */
+        struct Entry {
+            quint64 seq;
+            GidChunk chunk;
+            GidConsoleFormatter::Direction dir;
+            int offset;
+            qint64 gapBytes;
+        };
+        QQueue<Entry> queue;
+        int queuedBytes = 0;
+        quint64 nextSeq = 0;
+        /* Sequence number of the next chunk to be displayed. Chunks from it
+         * up to the next one that is displayed were dropped. */
+        quint64 displaySeq = 0;
+        // Bytes dropped before the front of the queue
+        qint64 droppedBytes = 0;
+        struct Piece {
+            GidChunk chunk;
+            GidConsoleFormatter::Direction dir;
+            // Dropped before this piece
+            int gapChunks;
+            qint64 gapBytes;
+        };
+        int take(int n, QList<Piece>& batch);
+        int drop(int n);
+        void noteDropped(qint64 bytes, Entry* next = nullptr);
+        GidSpillFile spill;
+        bool spillFullReported = false;
+        bool spillEntry(const Entry& e);
+        /* Chunks that could not be spilled because the file is full or can't
+         * be written wait here until the file has been read. */
+        QQueue<Entry> held;
+        int heldBytes = 0;
+        void releaseHeld();
+        int dropHeld(int n);
+        void dropSpilled();
+        void spillBacklog(int n);
+        void pageIn();
+        void spillError();
+        void spillChanged();
     } dataDisplay {this};
 
+    // Lost serial port and TCP client connections are reopened in the
+    // background with increasing intervals
+    GidReconnectSupervisor reconnectSupervisor;
+    void setupReconnect();
+    void reconnectLater();
+    void onReconnectAttempt();
+    void updateReconnectStats();
+
+    bool firstDataReceived = false;
+
 private slots:
-    void onDataReceived(QByteArray data);
+    void onDataReceived(GidChunk chunk);
     void sendData(QByteArray data, bool allowEscapeSequenceReplace = true);
 
+private:
+    bool transmit(const QByteArray& data);
+    bool canTransmit();
+    qint64 bytesToWrite();
+    void countReceived(int bytes);
+
     // Serial
 private:
     GidQt5Serial serial;
     void setupSerial();
     void sendSerial(QByteArray data);
     void closeSerialPort();
+    // Received data is left in the port's buffer for the coalescing window
+    // and then read in one chunk. Like other chunks, it is timestamped when
+    // its last data arrived, i.e. its last readyRead.
+    QBasicTimer serialCoalesceTimer;
+    GidTimestamp serialCoalesceTimestamp;
+    void onSerialCoalesceTimer();
 private slots:
     void onSerialReadyRead();
     void onSerialError(QSerialPort::SerialPortError error);
@@ -150,7 +422,11 @@ private slots:
 private:
     void setupNetwork();
 
+    void updateSocketOptions();
+
     GidTcp tcp;
+    QHostAddress mTcpClientAddress;
+    quint16 mTcpClientPort = 0;
     void sendTcpServer(QByteArray data);
     void sendTcpClient(QByteArray data);
     void stopTcpServer();
@@ -164,10 +440,10 @@ private slots:
 
 private:
     GidUdp udp;
-    int mUdpSendPort = 0;
-    bool mUdpSendBroadcast = false;
-    QString mUdpSendIp;
+    // Why nothing is sent if the send address is empty or invalid
+    QString udpTargetsError;
     void sendUdp(QByteArray data);
+    void updateMulticastInterfaces();
     void stopUdp();
 private slots:
     void printUdp(QString msg);
@@ -231,6 +507,37 @@ private slots:
     void on_spinBox_maxProcessTimeMs_valueChanged(int value);
 
     void on_spinBox_displayBacklogLengthMs_valueChanged(int value);
+    void on_checkBox_displaySpill_toggled(bool checked);
+    void on_spinBox_displaySpillMaxMb_valueChanged(int value);
+    void on_pushButton_jumpToLive_clicked();
+
+    void on_spinBox_guiRefreshRateHz_valueChanged(int value);
+
+    void on_spinBox_udp_displayRateLimit_valueChanged(int value);
+
+    void on_radioButton_displayMode_hexDump_toggled(bool checked);
+    void on_comboBox_hexDumpBytesPerRow_currentIndexChanged(int index);
+
+    void on_pushButton_plot_clear_clicked();
+    void on_spinBox_plot_windowSeconds_valueChanged(int value);
+
+    void on_pushButton_latency_start_toggled(bool checked);
+    void on_spinBox_latency_intervalMs_valueChanged(int value);
+    void on_pushButton_latency_clear_clicked();
+    void on_pushButton_latency_export_clicked();
+
+    void on_pushButton_patternTest_start_toggled(bool checked);
+
+    void on_actionFind_triggered();
+    void on_pushButton_findNext_clicked();
+    void on_pushButton_findPrevious_clicked();
+    void on_toolButton_findClose_clicked();
+
+    void on_checkBox_metrics_http_clicked();
+    void on_spinBox_metrics_httpPort_editingFinished();
+    void on_checkBox_metrics_jsonFile_clicked();
+    void on_spinBox_metrics_jsonIntervalMs_editingFinished();
+    void on_lineEdit_metrics_jsonPath_editingFinished();
 
 private:
     QBasicTimer timedMsgTimer;
@@ -251,13 +558,17 @@ private:
     void initCheckableSetting(QString settingKey, QAbstractButton* widget);
     void initLineEditSetting(QString settingKey, QLineEdit* lineEdit);
     void initSpinBox(QString settingKey, QSpinBox* spinBox);
+    void initComboBoxSetting(QString settingKey, QComboBox* comboBox);
 
     void printNetworkAddresses();
+    void printNetworkAddresses(QList<QNetworkInterface> interfaces);
 
     const QString settingAutoScroll = "autoScroll";
     const QString settingCrLf = "crlf";
     const QString settingDisplayModeText = "displayModeText";
     const QString settingDisplayModeHex = "displayModeHex";
+    const QString settingDisplayModeHexDump = "displayModeHexDump";
+    const QString settingHexDumpBytesPerRow = "hexDumpBytesPerRow";
     const QString settingHexSpecial = "hexSpecial";
     const QString settingShowCrLfHex = "showCrLfHex";
     const QString settingNewlineForCrLf = "newlineForCrLf";
@@ -271,12 +582,51 @@ private:
     const QString settingUdpBindPort = "udpBindPort";
     const QString settingUdpSendBroadcast = "udpSendBroadcast";
     const QString settingUdpSendIp = "udpSendIp";
+    const QString settingUdpMulticastGroup = "udpMulticastGroup";
+    const QString settingUdpMulticastInterface = "udpMulticastInterface";
     const QString settingUdpSendPort = "udpSendPort";
     const QString settingSendFilePath = "sendFilePath";
     const QString settingSendFileFrequencyMs = "sendFileFrequencyMs";
     const QString settingSendFileExcludeEndingNewline = "sendFileExcludeEndingNewline";
     const QString settingSendFileSendMsgIfFileEmpty = "sendFileSendMsgIfFileEmpty";
     const QString settingSendFileMsgIfEmpty = "sendFileMsgIfEmpty";
+    const QString settingFramingMode = "framingMode";
+    const QString settingFramingDelimiter = "framingDelimiter";
+    const QString settingFramingKeepDelimiter = "framingKeepDelimiter";
+    const QString settingFramingLengthSize = "framingLengthSize";
+    const QString settingFramingLengthBigEndian = "framingLengthBigEndian";
+    const QString settingFramingLengthOffset = "framingLengthOffset";
+    const QString settingFramingLengthIncludesHeader = "framingLengthIncludesHeader";
+    const QString settingFramingMaxFrameSize = "framingMaxFrameSize";
+    const QString settingUdpDatagrams = "udpDatagrams";
+    const QString settingUdpDisplayRateLimit = "udpDisplayRateLimit";
+    const QString settingDecoder = "decoder";
+    const QString settingDecoderShowRaw = "decoderShowRaw";
+    const QString settingPlotEnable = "plotEnable";
+    const QString settingPlotPattern = "plotPattern";
+    const QString settingPlotWindowSeconds = "plotWindowSeconds";
+    const QString settingDisplayReceivedData = "displayReceivedData";
+    const QString settingLatencyRequest = "latencyRequest";
+    const QString settingLatencyResponse = "latencyResponse";
+    const QString settingLatencyIntervalMs = "latencyIntervalMs";
+    const QString settingLatencyTimeoutMs = "latencyTimeoutMs";
+    const QString settingPatternTestPattern = "patternTestPattern";
+    const QString settingPatternTestSeed = "patternTestSeed";
+    const QString settingPatternTestVerify = "patternTestVerify";
+    const QString settingAutoReconnect = "autoReconnect";
+    const QString settingReconnectMaxDelayS = "reconnectMaxDelayS";
+    const QString settingSocketNoDelay = "socketNoDelay";
+    const QString settingSocketKeepAlive = "socketKeepAlive";
+    const QString settingSocketReceiveBufferKb = "socketReceiveBufferKb";
+    const QString settingSocketSendBufferKb = "socketSendBufferKb";
+    const QString settingSocketTypeOfService = "socketTypeOfService";
+    const QString settingMetricsHttp = "metricsHttp";
+    const QString settingMetricsHttpPort = "metricsHttpPort";
+    const QString settingMetricsJsonFile = "metricsJsonFile";
+    const QString settingMetricsJsonIntervalMs = "metricsJsonIntervalMs";
+    const QString settingMetricsJsonPath = "metricsJsonPath";
+    const QString settingDisplaySpill = "displaySpill";
+    const QString settingDisplaySpillMaxMb = "displaySpillMaxMb";
 };
 
 #endif // MAINWINDOW_H